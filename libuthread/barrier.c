@@ -0,0 +1,217 @@
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "barrier.h"
+#include "futex.h"
+
+struct barrier
+{
+	uint32_t _count;	  /* number of threads per phase */
+	uint32_t _remaining;  /* threads yet to arrive in the current phase */
+	uint32_t _generation; /* futex word: current phase */
+	uint32_t _sleepers;	  /* threads sleeping on _generation */
+} barrier;
+
+struct latch
+{
+	uint32_t _count;	/* current count */
+	uint32_t _released; /* futex word: set once _count reached zero */
+	uint32_t _sleepers; /* threads sleeping on _released */
+} latch;
+
+/* sleep as long as *@addr is @val, keeping track of sleepers in @sleepers */
+static void sleepWhile(uint32_t *addr, uint32_t val, uint32_t *sleepers)
+{
+	__atomic_add_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+
+	while (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == val)
+	{
+		futex_wait(addr, val, NULL, 0);
+	}
+
+	__atomic_sub_fetch(sleepers, 1, __ATOMIC_RELEASE);
+}
+
+/* release everybody sleeping on @addr with a single system call */
+static void wakeAll(uint32_t *addr, uint32_t *sleepers)
+{
+	if (__atomic_load_n(sleepers, __ATOMIC_SEQ_CST) > 0)
+	{
+		futex_wake(addr, INT_MAX, 0);
+	}
+}
+
+barrier_t barrier_create(unsigned int count)
+{
+	if (count == 0)
+	{
+		return NULL;
+	}
+
+	barrier_t b = malloc(sizeof(barrier));
+
+	if (b == NULL)
+	{
+		return NULL;
+	}
+
+	b->_count = count;
+	b->_remaining = count;
+	b->_generation = 0;
+	b->_sleepers = 0;
+
+	return b;
+}
+
+int barrier_destroy(barrier_t b)
+{
+	if (b == NULL || __atomic_load_n(&b->_remaining, __ATOMIC_ACQUIRE) !=
+						 b->_count ||
+		__atomic_load_n(&b->_sleepers, __ATOMIC_ACQUIRE) > 0)
+	{
+		return -1;
+	}
+
+	free(b);
+
+	return 0;
+}
+
+int barrier_wait(barrier_t b)
+{
+	if (b == NULL)
+	{
+		return -1;
+	}
+
+	/* must be read before arriving, the phase may end right after */
+	uint32_t generation = __atomic_load_n(&b->_generation, __ATOMIC_ACQUIRE);
+
+	if (__atomic_sub_fetch(&b->_remaining, 1, __ATOMIC_ACQ_REL) > 0)
+	{
+		sleepWhile(&b->_generation, generation, &b->_sleepers);
+		return 0;
+	}
+
+	/* last one in: arm the next phase, then release this one */
+	__atomic_store_n(&b->_remaining, b->_count, __ATOMIC_RELAXED);
+	__atomic_store_n(&b->_generation, generation + 1, __ATOMIC_SEQ_CST);
+	wakeAll(&b->_generation, &b->_sleepers);
+
+	return 1;
+}
+
+latch_t latch_create(unsigned int count)
+{
+	latch_t l = malloc(sizeof(latch));
+
+	if (l == NULL)
+	{
+		return NULL;
+	}
+
+	l->_count = count;
+	l->_released = count == 0;
+	l->_sleepers = 0;
+
+	return l;
+}
+
+int latch_destroy(latch_t l)
+{
+	if (l == NULL || __atomic_load_n(&l->_sleepers, __ATOMIC_ACQUIRE) > 0)
+	{
+		return -1;
+	}
+
+	free(l);
+
+	return 0;
+}
+
+int latch_count_down(latch_t l, unsigned int count)
+{
+	if (l == NULL)
+	{
+		return -1;
+	}
+
+	uint32_t current = __atomic_load_n(&l->_count, __ATOMIC_RELAXED);
+
+	do
+	{
+		if (count > current)
+		{
+			return -1;
+		}
+	} while (!__atomic_compare_exchange_n(&l->_count, &current,
+										  current - count, 1, __ATOMIC_ACQ_REL,
+										  __ATOMIC_RELAXED));
+
+	if (current == count && count > 0)
+	{
+		__atomic_store_n(&l->_released, 1, __ATOMIC_SEQ_CST);
+		wakeAll(&l->_released, &l->_sleepers);
+	}
+
+	return 0;
+}
+
+int latch_add(latch_t l, unsigned int count)
+{
+	if (l == NULL)
+	{
+		return -1;
+	}
+
+	uint32_t current = __atomic_load_n(&l->_count, __ATOMIC_RELAXED);
+
+	do
+	{
+		if (current == 0 || count > UINT32_MAX - current)
+		{
+			return -1; /* released latches stay released */
+		}
+	} while (!__atomic_compare_exchange_n(&l->_count, &current,
+										  current + count, 1, __ATOMIC_RELAXED,
+										  __ATOMIC_RELAXED));
+
+	return 0;
+}
+
+int latch_wait(latch_t l)
+{
+	if (l == NULL)
+	{
+		return -1;
+	}
+
+	if (!__atomic_load_n(&l->_released, __ATOMIC_ACQUIRE))
+	{
+		sleepWhile(&l->_released, 0, &l->_sleepers);
+	}
+
+	return 0;
+}
+
+int latch_try_wait(latch_t l)
+{
+	if (l == NULL || !__atomic_load_n(&l->_released, __ATOMIC_ACQUIRE))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+int latch_arrive_and_wait(latch_t l)
+{
+	if (latch_count_down(l, 1) == -1)
+	{
+		return -1;
+	}
+
+	return latch_wait(l);
+}
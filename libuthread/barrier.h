@@ -0,0 +1,125 @@
+#ifndef _BARRIER_H
+#define _BARRIER_H
+
+/*
+ * barrier_t - Barrier type
+ *
+ * A barrier makes a fixed number of threads wait for each other: each thread
+ * reaching the barrier is blocked until all of them have reached it, at which
+ * point they are all released at once and the barrier is ready for the next
+ * phase. Arriving at the barrier is a single atomic operation and releasing
+ * the blocked threads a single wake-up call, whatever their number.
+ */
+typedef struct barrier *barrier_t;
+
+/*
+ * barrier_create - Create barrier
+ * @count: Number of threads synchronizing on the barrier
+ *
+ * Return: Pointer to initialized barrier. NULL if @count is 0, or in case of
+ * failure when allocating the new barrier.
+ */
+barrier_t barrier_create(unsigned int count);
+
+/*
+ * barrier_destroy - Deallocate a barrier
+ * @barrier: Barrier to deallocate
+ *
+ * Return: -1 if @barrier is NULL or if threads are still waiting on it. 0 if
+ * @barrier was successfully destroyed.
+ */
+int barrier_destroy(barrier_t barrier);
+
+/*
+ * barrier_wait - Wait on a barrier
+ * @barrier: Barrier to wait on
+ *
+ * Block the caller thread until all the threads of barrier @barrier have
+ * called this function for the current phase.
+ *
+ * Return: -1 if @barrier is NULL. 1 for the last thread reaching the barrier,
+ * which may then perform work on behalf of the others, and 0 for all other
+ * threads.
+ */
+int barrier_wait(barrier_t barrier);
+
+/*
+ * latch_t - Latch type
+ *
+ * A latch is a single-use countdown: it starts with an internal count, threads
+ * count it down as they complete their part of a job, and all the threads
+ * waiting on the latch are released at once when the count reaches zero. As
+ * long as it has not been released, the count can also be raised to account
+ * for work discovered along the way.
+ */
+typedef struct latch *latch_t;
+
+/*
+ * latch_create - Create latch
+ * @count: Initial count of the latch
+ *
+ * Return: Pointer to initialized latch, already released if @count is 0. NULL
+ * in case of failure when allocating the new latch.
+ */
+latch_t latch_create(unsigned int count);
+
+/*
+ * latch_destroy - Deallocate a latch
+ * @latch: Latch to deallocate
+ *
+ * Return: -1 if @latch is NULL or if threads are still waiting on it. 0 if
+ * @latch was successfully destroyed.
+ */
+int latch_destroy(latch_t latch);
+
+/*
+ * latch_count_down - Count a latch down
+ * @latch: Latch to count down
+ * @count: Amount to subtract from the count
+ *
+ * Subtract @count from the count of latch @latch, releasing the waiting
+ * threads if it reaches zero.
+ *
+ * Return: -1 if @latch is NULL or if @count is greater than the current count.
+ * 0 if @latch was successfully counted down.
+ */
+int latch_count_down(latch_t latch, unsigned int count);
+
+/*
+ * latch_add - Raise the count of a latch
+ * @latch: Latch to count up
+ * @count: Amount to add to the count
+ *
+ * Return: -1 if @latch is NULL, already released, or if its count would
+ * overflow. 0 if the count of @latch was successfully raised.
+ */
+int latch_add(latch_t latch, unsigned int count);
+
+/*
+ * latch_wait - Wait for a latch to be released
+ * @latch: Latch to wait on
+ *
+ * Block the caller thread until the count of latch @latch reaches zero.
+ *
+ * Return: -1 if @latch is NULL. 0 once @latch is released.
+ */
+int latch_wait(latch_t latch);
+
+/*
+ * latch_try_wait - Check whether a latch is released
+ * @latch: Latch to check
+ *
+ * Return: -1 if @latch is NULL or not released yet. 0 if @latch is released.
+ */
+int latch_try_wait(latch_t latch);
+
+/*
+ * latch_arrive_and_wait - Count a latch down by one and wait for it
+ * @latch: Latch to count down and wait on
+ *
+ * Return: -1 if @latch is NULL or already released. 0 once @latch is
+ * released.
+ */
+int latch_arrive_and_wait(latch_t latch);
+
+#endif /* _BARRIER_H */
@@ -0,0 +1,433 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "chan.h"
+#include "queue.h"
+#include "thread.h"
+
+/* the two sides of a channel */
+#define SEND 0
+#define RECV 1
+
+struct channel
+{
+	void **_buffer;		/* ring of items, its size is a power of two */
+	size_t _mask;		/* size of the ring - 1 */
+	size_t _capacity;	/* maximum number of items in the channel */
+	chan_mode_t _mode;
+	int _closed;
+	queue_t _waiters[2]; /* tids of blocked senders and receivers */
+	int _blocked[2];	 /* number of blocked senders and receivers */
+	size_t _head;		 /* position of the next item to receive */
+	char _pad[64];		 /* keep both positions on separate cache lines */
+	size_t _tail;		 /* position of the next item to send */
+} channel;
+
+/*
+ * In SPSC mode, _tail is only written by the sender and _head only by the
+ * receiver, each publishing the items or slots it is done with through a
+ * release store. In MPMC mode, all the accesses are done within the critical
+ * section.
+ */
+
+/* move up to @count items into the ring, return how many were moved */
+static size_t put(chan_t chan, void **items, size_t count)
+{
+	size_t tail = chan->_tail;
+	size_t head = __atomic_load_n(&chan->_head, __ATOMIC_ACQUIRE);
+	size_t n = chan->_capacity - (tail - head);
+	size_t i;
+
+	if (n > count)
+	{
+		n = count;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		chan->_buffer[(tail + i) & chan->_mask] = items[i];
+	}
+
+	__atomic_store_n(&chan->_tail, tail + n, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/* move up to @count items out of the ring, return how many were moved */
+static size_t get(chan_t chan, void **items, size_t count)
+{
+	size_t head = chan->_head;
+	size_t tail = __atomic_load_n(&chan->_tail, __ATOMIC_ACQUIRE);
+	size_t n = tail - head;
+	size_t i;
+
+	if (n > count)
+	{
+		n = count;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		items[i] = chan->_buffer[(head + i) & chan->_mask];
+	}
+
+	__atomic_store_n(&chan->_head, head + n, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/* check whether @side could transfer an item right now */
+static int isReady(chan_t chan, int side)
+{
+	size_t head = __atomic_load_n(&chan->_head, __ATOMIC_ACQUIRE);
+	size_t tail = __atomic_load_n(&chan->_tail, __ATOMIC_ACQUIRE);
+
+	if (side == SEND)
+	{
+		return tail - head < chan->_capacity;
+	}
+
+	return tail != head;
+}
+
+/*
+ * Block the caller on @side of the channel, unless the other side made
+ * progress in the meantime. Must be called within the critical section.
+ */
+static void waitReady(chan_t chan, int side)
+{
+	pthread_t tid = pthread_self();
+	queue_handle_t handle;
+
+	if (queue_enqueue_handle(chan->_waiters[side], (void *)tid, &handle) == -1)
+	{
+		return; /* cannot block, the caller will try again */
+	}
+
+	/* pairs with the fence in wakeUp(): either side sees the other */
+	__atomic_add_fetch(&chan->_blocked[side], 1, __ATOMIC_SEQ_CST);
+
+	if (isReady(chan, side) || chan->_closed)
+	{
+		queue_delete_handle(chan->_waiters[side], handle);
+		__atomic_sub_fetch(&chan->_blocked[side], 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	thread_block();
+}
+
+/*
+ * Wake up to @count threads blocked on @side of the channel. Must be called
+ * within the critical section.
+ */
+static void wakeUpLocked(chan_t chan, int side, size_t count)
+{
+	pthread_t tid;
+
+	while (count-- > 0 &&
+		   queue_dequeue(chan->_waiters[side], (void **)&tid) == 0)
+	{
+		__atomic_sub_fetch(&chan->_blocked[side], 1, __ATOMIC_RELAXED);
+		thread_unblock(tid);
+	}
+}
+
+/*
+ * Same as wakeUpLocked(), but must be called outside the critical section,
+ * which is only entered when someone is blocked
+ */
+static void wakeUp(chan_t chan, int side, size_t count)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&chan->_blocked[side], __ATOMIC_RELAXED) == 0)
+	{
+		return; /* common case: nobody to wake up, no locking */
+	}
+
+	enter_critical_section();
+	wakeUpLocked(chan, side, count);
+	exit_critical_section();
+}
+
+chan_t chan_create(size_t capacity, chan_mode_t mode)
+{
+	size_t size = 1;
+
+	if (capacity == 0 || (mode != CHAN_SPSC && mode != CHAN_MPMC))
+	{
+		return NULL;
+	}
+
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	chan_t chan = malloc(sizeof(channel));
+
+	if (chan == NULL)
+	{
+		return NULL;
+	}
+
+	chan->_buffer = malloc(size * sizeof(void *));
+	chan->_waiters[SEND] = queue_create();
+	chan->_waiters[RECV] = queue_create();
+
+	if (chan->_buffer == NULL || chan->_waiters[SEND] == NULL ||
+		chan->_waiters[RECV] == NULL)
+	{
+		queue_destroy(chan->_waiters[SEND]);
+		queue_destroy(chan->_waiters[RECV]);
+		free(chan->_buffer);
+		free(chan);
+		return NULL;
+	}
+
+	chan->_mask = size - 1;
+	chan->_capacity = capacity;
+	chan->_mode = mode;
+	chan->_closed = 0;
+	chan->_blocked[SEND] = 0;
+	chan->_blocked[RECV] = 0;
+	chan->_head = 0;
+	chan->_tail = 0;
+
+	return chan;
+}
+
+int chan_destroy(chan_t chan)
+{
+	if (chan == NULL || chan->_blocked[SEND] > 0 || chan->_blocked[RECV] > 0)
+	{
+		return -1;
+	}
+
+	queue_destroy(chan->_waiters[SEND]);
+	queue_destroy(chan->_waiters[RECV]);
+	free(chan->_buffer);
+	free(chan);
+
+	return 0;
+}
+
+int chan_close(chan_t chan)
+{
+	if (chan == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	__atomic_store_n(&chan->_closed, 1, __ATOMIC_RELEASE);
+
+	/* every blocked thread has to notice */
+	wakeUpLocked(chan, SEND, SIZE_MAX);
+	wakeUpLocked(chan, RECV, SIZE_MAX);
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int chan_send_batch(chan_t chan, void **items, size_t count)
+{
+	size_t sent = 0;
+
+	if (chan == NULL || items == NULL)
+	{
+		return -1;
+	}
+
+	int locked = chan->_mode == CHAN_MPMC;
+
+	if (locked)
+	{
+		enter_critical_section();
+	}
+
+	while (sent < count && !__atomic_load_n(&chan->_closed, __ATOMIC_ACQUIRE))
+	{
+		size_t n = put(chan, items + sent, count - sent);
+
+		if (n > 0)
+		{
+			sent += n;
+
+			if (locked)
+			{
+				wakeUpLocked(chan, RECV, n);
+			}
+			else
+			{
+				wakeUp(chan, RECV, n);
+			}
+
+			continue;
+		}
+
+		/* channel is full, wait for a receiver to make room */
+		if (!locked)
+		{
+			enter_critical_section();
+		}
+
+		waitReady(chan, SEND);
+
+		if (!locked)
+		{
+			exit_critical_section();
+		}
+	}
+
+	if (locked)
+	{
+		exit_critical_section();
+	}
+
+	if (sent == 0 && count > 0)
+	{
+		return -1; /* closed */
+	}
+
+	return sent;
+}
+
+int chan_send(chan_t chan, void *item)
+{
+	return chan_send_batch(chan, &item, 1) == 1 ? 0 : -1;
+}
+
+int chan_trysend(chan_t chan, void *item)
+{
+	size_t n = 0;
+
+	if (chan == NULL)
+	{
+		return -1;
+	}
+
+	if (chan->_mode == CHAN_MPMC)
+	{
+		enter_critical_section();
+	}
+
+	if (!__atomic_load_n(&chan->_closed, __ATOMIC_ACQUIRE))
+	{
+		n = put(chan, &item, 1);
+	}
+
+	if (chan->_mode == CHAN_MPMC)
+	{
+		wakeUpLocked(chan, RECV, n);
+		exit_critical_section();
+	}
+	else if (n > 0)
+	{
+		wakeUp(chan, RECV, n);
+	}
+
+	return n > 0 ? 0 : -1;
+}
+
+int chan_recv_batch(chan_t chan, void **items, size_t count)
+{
+	int ret;
+
+	if (chan == NULL || items == NULL || count == 0)
+	{
+		return -1;
+	}
+
+	int locked = chan->_mode == CHAN_MPMC;
+
+	if (locked)
+	{
+		enter_critical_section();
+	}
+
+	while (1)
+	{
+		/* items sent before the channel got closed are still received */
+		int closed = __atomic_load_n(&chan->_closed, __ATOMIC_ACQUIRE);
+		size_t n = get(chan, items, count);
+
+		if (n > 0)
+		{
+			if (locked)
+			{
+				wakeUpLocked(chan, SEND, n);
+			}
+			else
+			{
+				wakeUp(chan, SEND, n);
+			}
+
+			ret = n;
+			break;
+		}
+
+		if (closed)
+		{
+			ret = -1;
+			break;
+		}
+
+		/* channel is empty, wait for a sender */
+		if (!locked)
+		{
+			enter_critical_section();
+		}
+
+		waitReady(chan, RECV);
+
+		if (!locked)
+		{
+			exit_critical_section();
+		}
+	}
+
+	if (locked)
+	{
+		exit_critical_section();
+	}
+
+	return ret;
+}
+
+int chan_recv(chan_t chan, void **item)
+{
+	return chan_recv_batch(chan, item, 1) == 1 ? 0 : -1;
+}
+
+int chan_tryrecv(chan_t chan, void **item)
+{
+	size_t n;
+
+	if (chan == NULL || item == NULL)
+	{
+		return -1;
+	}
+
+	if (chan->_mode == CHAN_MPMC)
+	{
+		enter_critical_section();
+	}
+
+	n = get(chan, item, 1);
+
+	if (chan->_mode == CHAN_MPMC)
+	{
+		wakeUpLocked(chan, SEND, n);
+		exit_critical_section();
+	}
+	else if (n > 0)
+	{
+		wakeUp(chan, SEND, n);
+	}
+
+	return n > 0 ? 0 : -1;
+}
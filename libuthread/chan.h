@@ -0,0 +1,143 @@
+#ifndef _CHAN_H
+#define _CHAN_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * chan_t - Channel type
+ *
+ * A channel is a bounded FIFO buffer through which threads pass data items
+ * (i.e. pointers) to each other. Sending to a full channel blocks the sender
+ * until room is made by a receiver, and receiving from an empty channel blocks
+ * the receiver until an item is sent. Batches of items can be moved with a
+ * single operation, and therefore at most a single wake-up.
+ */
+typedef struct channel *chan_t;
+
+/*
+ * chan_mode_t - Channel concurrency mode
+ *
+ * CHAN_SPSC: a single thread sends to the channel and a single thread receives
+ * from it (they may change over time, but never operate concurrently). Items
+ * are transferred without locking; the critical section is only entered when a
+ * thread has to block or to be woken up.
+ *
+ * CHAN_MPMC: any number of threads send and receive concurrently. Transfers
+ * happen within the critical section.
+ */
+typedef enum {
+	CHAN_SPSC,
+	CHAN_MPMC,
+} chan_mode_t;
+
+/*
+ * chan_create - Create channel
+ * @capacity: Maximum number of items held by the channel
+ * @mode: Concurrency mode of the channel
+ *
+ * Allocate and initialize an empty channel able to hold @capacity items.
+ *
+ * Return: Pointer to initialized channel. NULL if @capacity is 0 or @mode is
+ * invalid, or in case of failure when allocating the new channel.
+ */
+chan_t chan_create(size_t capacity, chan_mode_t mode);
+
+/*
+ * chan_destroy - Deallocate a channel
+ * @chan: Channel to deallocate
+ *
+ * Deallocate channel @chan. Items still held by the channel are dropped.
+ *
+ * Return: -1 if @chan is NULL or if other threads are still being blocked on
+ * @chan. 0 if @chan was successfully destroyed.
+ */
+int chan_destroy(chan_t chan);
+
+/*
+ * chan_close - Close a channel
+ * @chan: Channel to close
+ *
+ * Prevent further items from being sent to channel @chan, and wake up all the
+ * threads blocked on it. Items already in the channel can still be received.
+ *
+ * Return: -1 if @chan is NULL. 0 if @chan was successfully closed.
+ */
+int chan_close(chan_t chan);
+
+/*
+ * chan_send - Send an item
+ * @chan: Channel to send to
+ * @item: Data item to send
+ *
+ * Send @item to channel @chan, blocking while the channel is full.
+ *
+ * Return: -1 if @chan is NULL or closed. 0 if @item was successfully sent.
+ */
+int chan_send(chan_t chan, void *item);
+
+/*
+ * chan_trysend - Send an item without blocking
+ * @chan: Channel to send to
+ * @item: Data item to send
+ *
+ * Return: -1 if @chan is NULL, closed or full. 0 if @item was successfully
+ * sent.
+ */
+int chan_trysend(chan_t chan, void *item);
+
+/*
+ * chan_send_batch - Send several items
+ * @chan: Channel to send to
+ * @items: Array of data items to send
+ * @count: Number of items in @items
+ *
+ * Send the @count items of @items to channel @chan, in order. Whenever the
+ * channel is full the caller is blocked, and as many items as there is room
+ * for are transferred at once when it is woken up.
+ *
+ * Return: -1 if @chan or @items are NULL, or if @chan was closed before any
+ * item could be sent. Otherwise the number of items sent, which is lower than
+ * @count only if @chan got closed in the meantime.
+ */
+int chan_send_batch(chan_t chan, void **items, size_t count);
+
+/*
+ * chan_recv - Receive an item
+ * @chan: Channel to receive from
+ * @item: Address of data pointer where item is received
+ *
+ * Receive the oldest item of channel @chan into @item, blocking while the
+ * channel is empty.
+ *
+ * Return: -1 if @chan or @item are NULL, or if @chan is closed and empty. 0 if
+ * an item was successfully received.
+ */
+int chan_recv(chan_t chan, void **item);
+
+/*
+ * chan_tryrecv - Receive an item without blocking
+ * @chan: Channel to receive from
+ * @item: Address of data pointer where item is received
+ *
+ * Return: -1 if @chan or @item are NULL, or if @chan is empty. 0 if an item
+ * was successfully received.
+ */
+int chan_tryrecv(chan_t chan, void **item);
+
+/*
+ * chan_recv_batch - Receive several items
+ * @chan: Channel to receive from
+ * @items: Array receiving the data items
+ * @count: Maximum number of items to receive
+ *
+ * Receive up to @count of the oldest items of channel @chan into @items, in
+ * order. The caller is only blocked if the channel is empty, in which case it
+ * receives what is available when woken up.
+ *
+ * Return: -1 if @chan or @items are NULL, if @count is 0, or if @chan is closed
+ * and empty. Otherwise the number of items received.
+ */
+int chan_recv_batch(chan_t chan, void **items, size_t count);
+
+#endif /* _CHAN_H */
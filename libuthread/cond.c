@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "cond.h"
+#include "queue.h"
+#include "sem_cond.h"
+#include "thread.h"
+
+struct cond
+{
+	queue_t _waiters; /* waiting threads, see sem_cond.h */
+};
+
+cond_t cond_create(void)
+{
+	cond_t c = malloc(sizeof(struct cond));
+
+	if (c == NULL)
+	{
+		return NULL;
+	}
+
+	c->_waiters = queue_create();
+
+	if (c->_waiters == NULL)
+	{
+		free(c);
+		return NULL;
+	}
+
+	return c;
+}
+
+int cond_destroy(cond_t c)
+{
+	int ret = -1;
+
+	if (c == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	if (queue_length(c->_waiters) == 0)
+	{
+		queue_destroy(c->_waiters);
+		ret = 0;
+	}
+
+	exit_critical_section();
+
+	if (ret == 0)
+	{
+		free(c);
+	}
+
+	return ret;
+}
+
+int cond_wait(cond_t c, sem_t lock)
+{
+	if (c == NULL || lock == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	int ret = semCondWait(lock, c->_waiters);
+
+	exit_critical_section();
+
+	return ret;
+}
+
+int cond_signal(cond_t c)
+{
+	struct waiter *w;
+
+	if (c == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	if (queue_dequeue(c->_waiters, (void **)&w) == 0)
+	{
+		semCondMorph(w);
+	}
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int cond_broadcast(cond_t c)
+{
+	struct waiter *w;
+
+	if (c == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	/* all but the first waiter end up on the waiting list of their lock */
+	while (queue_dequeue(c->_waiters, (void **)&w) == 0)
+	{
+		semCondMorph(w);
+	}
+
+	exit_critical_section();
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef _COND_H
+#define _COND_H
+
+#include "sem.h"
+
+/*
+ * cond_t - Condition variable type
+ *
+ * A condition variable lets threads holding a lock, a semaphore of count one,
+ * wait for a condition on the data protected by the lock to become true. The
+ * threads signaled are not woken up right away: they are moved to the waiting
+ * list of the lock (wait morphing), and only run once the lock is released to
+ * them, so that broadcasting to many threads wakes them up one at a time
+ * instead of all of them competing for the lock.
+ *
+ * The lock must not be process-shared, and should be released by the thread
+ * that took it.
+ */
+typedef struct cond *cond_t;
+
+/*
+ * cond_create - Create condition variable
+ *
+ * Return: Pointer to initialized condition variable. NULL in case of failure
+ * when allocating the new condition variable.
+ */
+cond_t cond_create(void);
+
+/*
+ * cond_destroy - Deallocate a condition variable
+ * @cond: Condition variable to deallocate
+ *
+ * Return: -1 if @cond is NULL or if threads are still waiting on @cond. 0 if
+ * @cond was successfully destroyed.
+ */
+int cond_destroy(cond_t cond);
+
+/*
+ * cond_wait - Wait on a condition variable
+ * @cond: Condition variable to wait on
+ * @lock: Lock held by the caller thread
+ *
+ * Atomically release lock @lock and block the caller thread until it is
+ * signaled through condition variable @cond, then take @lock again before
+ * returning. As the condition may have changed again by then, it should be
+ * checked again in a loop.
+ *
+ * Return: -1 if @cond or @lock are NULL, if @lock is process-shared, or in
+ * case of failure when queueing the caller. 0 if the caller was signaled and
+ * holds @lock again.
+ */
+int cond_wait(cond_t cond, sem_t lock);
+
+/*
+ * cond_signal - Signal a condition variable
+ * @cond: Condition variable to signal
+ *
+ * Let the oldest thread waiting on condition variable @cond take its lock
+ * again, if any thread is waiting.
+ *
+ * Return: -1 if @cond is NULL. 0 otherwise.
+ */
+int cond_signal(cond_t cond);
+
+/*
+ * cond_broadcast - Signal a condition variable to all its waiters
+ * @cond: Condition variable to signal
+ *
+ * Let all the threads waiting on condition variable @cond take their lock
+ * again, in the order they started waiting.
+ *
+ * Return: -1 if @cond is NULL. 0 otherwise.
+ */
+int cond_broadcast(cond_t cond);
+
+#endif /* _COND_H */
@@ -0,0 +1,483 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cqueue.h"
+
+/*
+ * Bounded queues are rings of cells, each tagged with a sequence number telling
+ * which lap of the ring the cell is ready for. A producer claims position pos
+ * when the sequence of its cell equals pos, and publishes the item by setting
+ * it to pos + 1; a consumer claims position pos when the sequence equals
+ * pos + 1, and recycles the cell for the next lap by setting it to
+ * pos + capacity. Positions are claimed by compare-and-swap, so a full or empty
+ * queue is detected without ever waiting for another thread.
+ *
+ * Unbounded queues are linked lists of segments. Producers and consumers claim
+ * slots of the tail and head segments by fetch-and-add on their positions. A
+ * producer then stores its item in its slot, while a consumer swaps the slot
+ * with a TAKEN marker; if the consumer arrives first, the producer sees the
+ * marker and tries again with a fresh slot. A producer running off the end of
+ * the tail segment appends a new segment, and a consumer running off the end
+ * of the head segment moves the head to the next segment and retires the old
+ * one.
+ *
+ * Retired segments may still be read by threads which loaded them before they
+ * were unlinked. They are therefore only freed by the last thread leaving the
+ * queue, when no operation is in progress.
+ */
+
+#define CACHELINE 64
+#define SEGMENT_SIZE 256
+#define TAKEN ((void *)1) /* never a valid address */
+
+struct cell
+{
+	size_t _seq;
+	void *_data;
+};
+
+struct segment
+{
+	size_t _enq; /* next slot to claim by a producer */
+	char _pad[CACHELINE - sizeof(size_t)];
+	size_t _deq; /* next slot to claim by a consumer */
+	struct segment *_next;
+	struct segment *_retired; /* link in the list of retired segments */
+	void *_items[SEGMENT_SIZE];
+};
+
+typedef struct cqueue
+{
+	/* bounded queue */
+	struct cell *_cells;
+	size_t _mask;
+
+	/* unbounded queue */
+	struct segment *_retired; /* segments waiting to be freed */
+	size_t _active;			  /* number of operations in progress */
+
+	/* producers and consumers work on separate cache lines */
+	char _pad0[CACHELINE];
+	size_t _tail;			  /* next position to enqueue */
+	struct segment *_tailSeg; /* last segment */
+	char _pad1[CACHELINE - sizeof(size_t) - sizeof(void *)];
+	size_t _head;			  /* next position to dequeue */
+	struct segment *_headSeg; /* first segment */
+	char _pad2[CACHELINE - sizeof(size_t) - sizeof(void *)];
+} cqueue;
+
+static int boundedEnqueue(cqueue_t queue, void *data)
+{
+	size_t pos = __atomic_load_n(&queue->_tail, __ATOMIC_RELAXED);
+	struct cell *cell;
+	intptr_t diff;
+
+	for (;;)
+	{
+		cell = &queue->_cells[pos & queue->_mask];
+		diff = (intptr_t)(__atomic_load_n(&cell->_seq, __ATOMIC_ACQUIRE) - pos);
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&queue->_tail, &pos, pos + 1, 1,
+											__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			/* the cell still holds the item of the previous lap */
+			return -1;
+		}
+		else
+		{
+			pos = __atomic_load_n(&queue->_tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->_data = data;
+	__atomic_store_n(&cell->_seq, pos + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static int boundedDequeue(cqueue_t queue, void **data)
+{
+	size_t pos = __atomic_load_n(&queue->_head, __ATOMIC_RELAXED);
+	struct cell *cell;
+	intptr_t diff;
+
+	for (;;)
+	{
+		cell = &queue->_cells[pos & queue->_mask];
+		diff = (intptr_t)(__atomic_load_n(&cell->_seq, __ATOMIC_ACQUIRE) -
+						  (pos + 1));
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&queue->_head, &pos, pos + 1, 1,
+											__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			/* the item of this lap has not been enqueued yet */
+			return -1;
+		}
+		else
+		{
+			pos = __atomic_load_n(&queue->_head, __ATOMIC_RELAXED);
+		}
+	}
+
+	*data = cell->_data;
+	__atomic_store_n(&cell->_seq, pos + queue->_mask + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static struct segment *newSegment(void)
+{
+	return calloc(1, sizeof(struct segment));
+}
+
+/* whether @seg is the last segment and has no item left to dequeue */
+static int isDrained(struct segment *seg)
+{
+	size_t deq = __atomic_load_n(&seg->_deq, __ATOMIC_SEQ_CST);
+	size_t enq = __atomic_load_n(&seg->_enq, __ATOMIC_SEQ_CST);
+
+	if (enq > SEGMENT_SIZE)
+	{
+		enq = SEGMENT_SIZE;
+	}
+
+	return deq >= enq && __atomic_load_n(&seg->_next, __ATOMIC_SEQ_CST) == NULL;
+}
+
+/* start an operation on an unbounded queue */
+static void enter(cqueue_t queue)
+{
+	__atomic_fetch_add(&queue->_active, 1, __ATOMIC_SEQ_CST);
+}
+
+/* end an operation, freeing the retired segments if it was the last one */
+static void leave(cqueue_t queue)
+{
+	struct segment *list, *last, *seg;
+
+	if (__atomic_load_n(&queue->_retired, __ATOMIC_SEQ_CST) == NULL)
+	{
+		__atomic_fetch_sub(&queue->_active, 1, __ATOMIC_SEQ_CST);
+		return;
+	}
+
+	/*
+	 * Segments are grabbed before checking that no other operation is in
+	 * progress: any thread still holding one of them started before it was
+	 * retired, and is therefore counted.
+	 */
+	list = __atomic_exchange_n(&queue->_retired, NULL, __ATOMIC_SEQ_CST);
+
+	if (__atomic_sub_fetch(&queue->_active, 1, __ATOMIC_SEQ_CST) == 0)
+	{
+		while (list != NULL)
+		{
+			seg = list;
+			list = list->_retired;
+			free(seg);
+		}
+
+		return;
+	}
+
+	if (list == NULL)
+	{
+		return;
+	}
+
+	/* somebody else will have to free them */
+	for (last = list; last->_retired != NULL; last = last->_retired)
+		;
+
+	last->_retired = __atomic_load_n(&queue->_retired, __ATOMIC_RELAXED);
+
+	while (!__atomic_compare_exchange_n(&queue->_retired, &last->_retired, list,
+										1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		;
+}
+
+static void retire(cqueue_t queue, struct segment *seg)
+{
+	seg->_retired = __atomic_load_n(&queue->_retired, __ATOMIC_RELAXED);
+
+	while (!__atomic_compare_exchange_n(&queue->_retired, &seg->_retired, seg,
+										1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		;
+}
+
+static int unboundedEnqueue(cqueue_t queue, void *data)
+{
+	struct segment *tail, *next, *seg;
+	size_t idx;
+	void *empty;
+
+	enter(queue);
+
+	for (;;)
+	{
+		tail = __atomic_load_n(&queue->_tailSeg, __ATOMIC_SEQ_CST);
+		idx = __atomic_fetch_add(&tail->_enq, 1, __ATOMIC_SEQ_CST);
+
+		if (idx < SEGMENT_SIZE)
+		{
+			empty = NULL;
+
+			if (__atomic_compare_exchange_n(&tail->_items[idx], &empty, data, 0,
+											__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+			{
+				break;
+			}
+
+			/* a consumer gave up on this slot, try another one */
+			continue;
+		}
+
+		/* the tail segment is full, append a new one or help moving on */
+		if (tail != __atomic_load_n(&queue->_tailSeg, __ATOMIC_SEQ_CST))
+		{
+			continue;
+		}
+
+		next = __atomic_load_n(&tail->_next, __ATOMIC_SEQ_CST);
+
+		if (next != NULL)
+		{
+			__atomic_compare_exchange_n(&queue->_tailSeg, &tail, next, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		seg = newSegment();
+
+		if (seg == NULL)
+		{
+			leave(queue);
+			return -1;
+		}
+
+		seg->_items[0] = data;
+		seg->_enq = 1;
+
+		if (__atomic_compare_exchange_n(&tail->_next, &next, seg, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+			__atomic_compare_exchange_n(&queue->_tailSeg, &tail, seg, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+			break;
+		}
+
+		free(seg);
+	}
+
+	leave(queue);
+
+	return 0;
+}
+
+static int unboundedDequeue(cqueue_t queue, void **data)
+{
+	struct segment *head, *next;
+	size_t idx;
+	void *item;
+	int ret = -1;
+
+	enter(queue);
+
+	for (;;)
+	{
+		head = __atomic_load_n(&queue->_headSeg, __ATOMIC_SEQ_CST);
+
+		if (isDrained(head))
+		{
+			break;
+		}
+
+		idx = __atomic_fetch_add(&head->_deq, 1, __ATOMIC_SEQ_CST);
+
+		if (idx < SEGMENT_SIZE)
+		{
+			item = __atomic_exchange_n(&head->_items[idx], TAKEN,
+									   __ATOMIC_SEQ_CST);
+
+			if (item == NULL)
+			{
+				/* the producer of this slot has not stored its item yet */
+				continue;
+			}
+
+			*data = item;
+			ret = 0;
+			break;
+		}
+
+		/* the head segment is drained, move on to the next one */
+		next = __atomic_load_n(&head->_next, __ATOMIC_SEQ_CST);
+
+		if (next == NULL)
+		{
+			break;
+		}
+
+		if (__atomic_compare_exchange_n(&queue->_headSeg, &head, next, 0,
+										__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		{
+			retire(queue, head);
+		}
+	}
+
+	leave(queue);
+
+	return ret;
+}
+
+cqueue_t cqueue_create(size_t capacity)
+{
+	cqueue_t queue = malloc(sizeof(cqueue));
+	struct segment *seg;
+	size_t size = 1, i;
+
+	if (queue == NULL)
+	{
+		return NULL;
+	}
+
+	queue->_cells = NULL;
+	queue->_mask = 0;
+	queue->_retired = NULL;
+	queue->_active = 0;
+	queue->_head = 0;
+	queue->_tail = 0;
+	queue->_headSeg = NULL;
+	queue->_tailSeg = NULL;
+
+	if (capacity == 0)
+	{
+		seg = newSegment();
+
+		if (seg == NULL)
+		{
+			free(queue);
+			return NULL;
+		}
+
+		queue->_headSeg = seg;
+		queue->_tailSeg = seg;
+
+		return queue;
+	}
+
+	while (size < capacity)
+	{
+		size <<= 1;
+
+		if (size == 0)
+		{
+			free(queue);
+			return NULL;
+		}
+	}
+
+	queue->_cells = malloc(size * sizeof(struct cell));
+
+	if (queue->_cells == NULL)
+	{
+		free(queue);
+		return NULL;
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		queue->_cells[i]._seq = i;
+	}
+
+	queue->_mask = size - 1;
+
+	return queue;
+}
+
+int cqueue_destroy(cqueue_t queue)
+{
+	struct segment *head, *seg;
+
+	if (queue == NULL)
+	{
+		return -1;
+	}
+
+	if (queue->_cells != NULL)
+	{
+		if (queue->_head != queue->_tail)
+		{
+			return -1;
+		}
+
+		free(queue->_cells);
+		free(queue);
+
+		return 0;
+	}
+
+	head = queue->_headSeg;
+
+	if (!isDrained(head))
+	{
+		return -1;
+	}
+
+	while (queue->_retired != NULL)
+	{
+		seg = queue->_retired;
+		queue->_retired = seg->_retired;
+		free(seg);
+	}
+
+	free(head);
+	free(queue);
+
+	return 0;
+}
+
+int cqueue_enqueue(cqueue_t queue, void *data)
+{
+	if (queue == NULL || data == NULL)
+	{
+		return -1;
+	}
+
+	if (queue->_cells != NULL)
+	{
+		return boundedEnqueue(queue, data);
+	}
+
+	return unboundedEnqueue(queue, data);
+}
+
+int cqueue_dequeue(cqueue_t queue, void **data)
+{
+	if (queue == NULL || data == NULL)
+	{
+		return -1;
+	}
+
+	if (queue->_cells != NULL)
+	{
+		return boundedDequeue(queue, data);
+	}
+
+	return unboundedDequeue(queue, data);
+}
@@ -0,0 +1,72 @@
+#ifndef _CQUEUE_H
+#define _CQUEUE_H
+
+#include <stddef.h>
+
+/*
+ * cqueue_t - Concurrent queue type
+ *
+ * A concurrent queue is a FIFO data structure which any number of threads can
+ * enqueue to and dequeue from at the same time, without external locking (in
+ * particular, without entering the library's critical section). Operations
+ * never block: enqueueing to a full queue and dequeueing from an empty queue
+ * fail immediately.
+ *
+ * A queue is either bounded, in which case its items live in a fixed ring
+ * allocated at creation and operations never allocate memory, or unbounded, in
+ * which case items live in a linked list of fixed-size segments that are
+ * allocated and released as the queue grows and shrinks.
+ */
+typedef struct cqueue *cqueue_t;
+
+/*
+ * cqueue_create - Allocate an empty concurrent queue
+ * @capacity: Maximum number of items held by the queue, 0 for an unbounded
+ * queue
+ *
+ * Create a new concurrent queue. The capacity of a bounded queue is rounded up
+ * to the next power of two.
+ *
+ * Return: Pointer to new empty queue. NULL in case of failure when allocating
+ * the new queue.
+ */
+cqueue_t cqueue_create(size_t capacity);
+
+/*
+ * cqueue_destroy - Deallocate a concurrent queue
+ * @queue: Queue to deallocate
+ *
+ * Deallocate the memory associated to the queue object pointed by @queue. No
+ * other thread may be operating on the queue.
+ *
+ * Return: -1 if @queue is NULL or if @queue is not empty. 0 if @queue was
+ * successfully destroyed.
+ */
+int cqueue_destroy(cqueue_t queue);
+
+/*
+ * cqueue_enqueue - Enqueue data item
+ * @queue: Queue in which to enqueue item
+ * @data: Address of data item to enqueue
+ *
+ * Enqueue the address contained in @data in the queue @queue.
+ *
+ * Return: -1 if @queue or @data are NULL, if a bounded @queue is full, or in
+ * case of memory allocation error when growing an unbounded @queue. 0 if @data
+ * was successfully enqueued in @queue.
+ */
+int cqueue_enqueue(cqueue_t queue, void *data);
+
+/*
+ * cqueue_dequeue - Dequeue data item
+ * @queue: Queue in which to dequeue item
+ * @data: Address of data pointer where item is received
+ *
+ * Remove the oldest item of queue @queue and assign this item to @data.
+ *
+ * Return: -1 if @queue or @data are NULL, or if the queue is empty. 0 if @data
+ * was set with the oldest item available in @queue.
+ */
+int cqueue_dequeue(cqueue_t queue, void **data);
+
+#endif /* _CQUEUE_H */
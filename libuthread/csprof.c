@@ -0,0 +1,311 @@
+#define THREAD_NO_WRAP
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "csprof.h"
+#include "thread.h"
+
+#ifdef CS_PROFILE
+
+#define CSPROF_MAX_SITES 256 /* more than the library has */
+
+/* the wrappers of the tracer, when enabled, are in turn wrapped */
+#ifdef UTHREAD_TRACE
+#define enterSection traceEnterCriticalSection
+#define exitSection traceExitCriticalSection
+#define blockThread traceThreadBlock
+#else
+#define enterSection enter_critical_section
+#define exitSection exit_critical_section
+#define blockThread thread_block
+#endif
+
+/*
+ * Call sites, registered when first entering the critical section. They and
+ * their statistics are only accessed within the critical section, which is
+ * why entering it again before leaving it is fatal in profiled builds.
+ */
+static struct csprof_site *siteTable[CSPROF_MAX_SITES];
+static int siteCount;
+
+/* Critical section held by the calling thread */
+static __thread int inside;				   /* whether it is held */
+static __thread struct csprof_site *held; /* call site that entered it */
+static __thread uint64_t heldSince;	   /* when it was entered, in ns */
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Account for @time in the total, maximum and histogram of a statistic */
+static void record(uint64_t *total, uint64_t *max, uint64_t *hist,
+				   uint64_t time)
+{
+	unsigned int bucket = 63 - __builtin_clzll(time | 1);
+
+	if (bucket >= CSPROF_BUCKETS)
+	{
+		bucket = CSPROF_BUCKETS - 1;
+	}
+
+	*total += time;
+	hist[bucket]++;
+
+	if (time > *max)
+	{
+		*max = time;
+	}
+}
+
+static void endHold(uint64_t end)
+{
+	record(&held->hold_total_ns, &held->hold_max_ns, held->hold_hist,
+		   end - heldSince);
+}
+
+/*
+ * Noinline so that the return address is in the function of the call site, in
+ * which the entry macro expands
+ */
+__attribute__((noinline)) void csprofEnter(struct csprof_site *site)
+{
+	if (inside)
+	{
+		/* the critical section is not recursive: the thread would deadlock
+		 * or, as it is, leave it at the inner exit */
+		fprintf(stderr, "%s:%d: %s: critical section already entered at "
+						"%s:%d\n",
+				site->file, site->line, site->function, held->file,
+				held->line);
+		abort();
+	}
+
+	uint64_t start = now();
+
+	enterSection();
+
+	heldSince = now();
+	held = site;
+	inside = 1;
+
+	if (site->caller == NULL)
+	{
+		site->caller = __builtin_return_address(0);
+
+		if (siteCount < CSPROF_MAX_SITES)
+		{
+			siteTable[siteCount++] = site;
+		}
+	}
+
+	site->acquisitions++;
+	record(&site->wait_total_ns, &site->wait_max_ns, site->wait_hist,
+		   heldSince - start);
+}
+
+void csprofExit(void)
+{
+	if (inside)
+	{
+		endHold(now());
+		inside = 0;
+	}
+
+	exitSection();
+}
+
+int csprofThreadBlock(void)
+{
+	if (!inside)
+	{
+		return blockThread();
+	}
+
+	/* the critical section is left while blocked */
+	endHold(now());
+
+	int ret = blockThread();
+
+	heldSince = now();
+
+	return ret;
+}
+
+/* Sort call sites by decreasing total wait time */
+static int compareWait(const void *a, const void *b)
+{
+	const struct csprof_site *x = a, *y = b;
+
+	return (x->wait_total_ns < y->wait_total_ns) -
+		   (x->wait_total_ns > y->wait_total_ns);
+}
+
+/* Copy the statistics of all call sites, return their number or -1 */
+static int snapshot(struct csprof_site **copy)
+{
+	int i, count;
+
+	enterSection();
+
+	count = siteCount;
+	*copy = malloc((count > 0 ? count : 1) * sizeof(struct csprof_site));
+
+	if (*copy == NULL)
+	{
+		exitSection();
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		(*copy)[i] = *siteTable[i];
+	}
+
+	exitSection();
+
+	qsort(*copy, count, sizeof(struct csprof_site), compareWait);
+
+	return count;
+}
+
+static void printHistogram(FILE *stream, const char *name,
+						   const uint64_t *hist)
+{
+	int i;
+
+	for (i = 0; i < CSPROF_BUCKETS; i++)
+	{
+		if (hist[i] > 0)
+		{
+			fprintf(stream, "  %s [%12luns, %12luns) %lu\n", name, 1UL << i,
+					2UL << i, (unsigned long)hist[i]);
+		}
+	}
+}
+
+#endif
+
+int csprof_top(struct csprof_site *sites, int max)
+{
+#ifdef CS_PROFILE
+	struct csprof_site *copy;
+	int count;
+
+	if (sites == NULL || max <= 0)
+	{
+		return -1;
+	}
+
+	count = snapshot(&copy);
+
+	if (count == -1)
+	{
+		return -1;
+	}
+
+	if (count > max)
+	{
+		count = max;
+	}
+
+	memcpy(sites, copy, count * sizeof(struct csprof_site));
+	free(copy);
+
+	return count;
+#else
+	return -1;
+#endif
+}
+
+int csprof_report(FILE *stream, int max)
+{
+#ifdef CS_PROFILE
+	struct csprof_site *copy, *s;
+	int i, count;
+
+	if (stream == NULL)
+	{
+		return -1;
+	}
+
+	count = snapshot(&copy);
+
+	if (count == -1)
+	{
+		return -1;
+	}
+
+	if (max > 0 && count > max)
+	{
+		count = max;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		s = &copy[i];
+
+		if (s->acquisitions == 0)
+		{
+			continue; /* since the last reset */
+		}
+
+		fprintf(stream, "%s:%d %s (%p): acquisitions %lu wait_total %luns"
+						" wait_avg %luns wait_max %luns hold_total %luns"
+						" hold_avg %luns hold_max %luns\n",
+				s->file, s->line, s->function, s->caller,
+				(unsigned long)s->acquisitions,
+				(unsigned long)s->wait_total_ns,
+				(unsigned long)(s->wait_total_ns / s->acquisitions),
+				(unsigned long)s->wait_max_ns,
+				(unsigned long)s->hold_total_ns,
+				(unsigned long)(s->hold_total_ns / s->acquisitions),
+				(unsigned long)s->hold_max_ns);
+
+		printHistogram(stream, "wait", s->wait_hist);
+		printHistogram(stream, "hold", s->hold_hist);
+	}
+
+	free(copy);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int csprof_reset(void)
+{
+#ifdef CS_PROFILE
+	struct csprof_site *s;
+	int i;
+
+	enterSection();
+
+	for (i = 0; i < siteCount; i++)
+	{
+		s = siteTable[i];
+
+		s->acquisitions = 0;
+		s->wait_total_ns = 0;
+		s->wait_max_ns = 0;
+		s->hold_total_ns = 0;
+		s->hold_max_ns = 0;
+		memset(s->wait_hist, 0, sizeof(s->wait_hist));
+		memset(s->hold_hist, 0, sizeof(s->hold_hist));
+	}
+
+	exitSection();
+
+	return 0;
+#else
+	return -1;
+#endif
+}
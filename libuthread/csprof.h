@@ -0,0 +1,89 @@
+#ifndef _CSPROF_H
+#define _CSPROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Critical section profiler
+ *
+ * All the threads of the library serialize on a single critical section. When
+ * the library is built with the profiler (`make CSPROF=1`), the time spent
+ * waiting to enter it and holding it is recorded for each call site entering
+ * it. Otherwise, the functions below fail.
+ *
+ * Holds end when the thread leaves the critical section or blocks within it,
+ * and start over when it wakes up. The critical section is not recursive: a
+ * thread entering it again before leaving it makes profiled builds abort,
+ * reporting both call sites.
+ */
+
+/*
+ * Number of buckets of the time histograms
+ */
+#define CSPROF_BUCKETS 32
+
+/*
+ * struct csprof_site - Critical section statistics of a call site
+ *
+ * @function: Name of the function entering the critical section
+ * @file: Name of the file of the function
+ * @line: Line of the call in the file
+ * @caller: Address the call returns to, in @function
+ * @acquisitions: Outermost entries into the critical section from the site
+ * @wait_total_ns: Total time spent waiting to enter
+ * @wait_max_ns: Longest time spent waiting to enter
+ * @wait_hist: Histogram of waits, bucket i counting waits from 2^i included to
+ * 2^(i+1) excluded nanoseconds (the last one counting all the longer waits)
+ * @hold_total_ns: Total time spent within the critical section
+ * @hold_max_ns: Longest time spent within the critical section
+ * @hold_hist: Histogram of holds, same buckets as @wait_hist
+ */
+struct csprof_site {
+	const char *function;
+	const char *file;
+	int line;
+	void *caller;
+	uint64_t acquisitions;
+	uint64_t wait_total_ns;
+	uint64_t wait_max_ns;
+	uint64_t wait_hist[CSPROF_BUCKETS];
+	uint64_t hold_total_ns;
+	uint64_t hold_max_ns;
+	uint64_t hold_hist[CSPROF_BUCKETS];
+};
+
+/*
+ * csprof_top - Get the most contended call sites
+ * @sites: Array receiving the statistics of the call sites
+ * @max: Size of @sites
+ *
+ * Fill @sites with the statistics of at most @max call sites having entered
+ * the critical section, by decreasing total wait time.
+ *
+ * Return: -1 if @sites is NULL, if @max is not positive, or if the profiler is
+ * disabled. Number of call sites filled otherwise.
+ */
+int csprof_top(struct csprof_site *sites, int max);
+
+/*
+ * csprof_report - Print the most contended call sites
+ * @stream: Stream to print to
+ * @max: Number of call sites to print, all of them if not positive
+ *
+ * Print the statistics of the call sites having entered the critical section
+ * to @stream by decreasing total wait time, one line per call site followed by
+ * the non-empty buckets of its wait and hold time histograms.
+ *
+ * Return: -1 if @stream is NULL or if the profiler is disabled. 0 otherwise.
+ */
+int csprof_report(FILE *stream, int max);
+
+/*
+ * csprof_reset - Forget the recorded statistics
+ *
+ * Return: -1 if the profiler is disabled. 0 otherwise.
+ */
+int csprof_reset(void);
+
+#endif /* _CSPROF_H */
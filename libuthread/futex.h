@@ -0,0 +1,51 @@
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include <linux/futex.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Thin wrappers around the futex system call, for internal use by the library.
+ *
+ * @shared selects whether the futex word may be shared between processes
+ * (i.e. lives in a shared mapping) or only between threads of the current
+ * process, which lets the kernel take a faster path.
+ */
+
+/*
+ * futex_wait - Sleep on a futex word
+ * @addr: Address of the futex word
+ * @val: Expected value of the futex word
+ * @timeout: (Optional) Maximum relative time to sleep
+ * @shared: Whether the word is shared between processes
+ *
+ * Return: -1 if *@addr was different than @val, if @timeout expired or if the
+ * sleep was interrupted (see errno). 0 when woken up by futex_wake().
+ */
+static inline int futex_wait(uint32_t *addr, uint32_t val,
+							 const struct timespec *timeout, int shared)
+{
+	int op = shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE;
+
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+/*
+ * futex_wake - Wake up threads sleeping on a futex word
+ * @addr: Address of the futex word
+ * @count: Maximum number of threads to wake up
+ * @shared: Whether the word is shared between processes
+ *
+ * Return: Number of threads woken up.
+ */
+static inline int futex_wake(uint32_t *addr, int count, int shared)
+{
+	int op = shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE;
+
+	return syscall(SYS_futex, addr, op, count, NULL, NULL, 0);
+}
+
+#endif /* _FUTEX_H */
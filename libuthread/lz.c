@@ -0,0 +1,225 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+#define LAST_LITERALS 8 /* never look for matches that close to the end */
+
+/* Hash of the 4 bytes at @p */
+static inline uint32_t hash(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Append the extra bytes of a length whose nibble overflowed */
+static uint8_t *putLength(uint8_t *op, uint8_t *oend, size_t n)
+{
+	while (n >= 255)
+	{
+		if (op == oend)
+		{
+			return NULL;
+		}
+
+		*op++ = 255;
+		n -= 255;
+	}
+
+	if (op == oend)
+	{
+		return NULL;
+	}
+
+	*op++ = (uint8_t)n;
+
+	return op;
+}
+
+/*
+ * Append a pair of @nlit literals at @lit and a match of @mlen bytes at
+ * @offset, or literals only if @mlen is 0. Return NULL if out of room.
+ */
+static uint8_t *putPair(uint8_t *op, uint8_t *oend, const uint8_t *lit,
+						size_t nlit, size_t offset, size_t mlen)
+{
+	uint8_t *token = op++;
+	size_t m = mlen ? mlen - MIN_MATCH : 0;
+
+	if (token >= oend)
+	{
+		return NULL;
+	}
+
+	*token = (uint8_t)((nlit < 15 ? nlit : 15) << 4 | (m < 15 ? m : 15));
+
+	if (nlit >= 15 && (op = putLength(op, oend, nlit - 15)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((size_t)(oend - op) < nlit)
+	{
+		return NULL;
+	}
+
+	memcpy(op, lit, nlit);
+	op += nlit;
+
+	if (mlen == 0)
+	{
+		return op;
+	}
+
+	if (oend - op < 2)
+	{
+		return NULL;
+	}
+
+	*op++ = (uint8_t)offset;
+	*op++ = (uint8_t)(offset >> 8);
+
+	if (m >= 15 && (op = putLength(op, oend, m - 15)) == NULL)
+	{
+		return NULL;
+	}
+
+	return op;
+}
+
+size_t lzCompress(const void *src, size_t len, void *dst, size_t cap)
+{
+	uint32_t table[1 << HASH_BITS]; /* last position + 1 of each hash */
+	const uint8_t *in = src;
+	const uint8_t *end = in + len;
+	const uint8_t *limit = len > LAST_LITERALS ? end - LAST_LITERALS : in;
+	const uint8_t *ip = in, *anchor = in, *ref;
+	uint8_t *op = dst, *oend = op + cap;
+	size_t mlen;
+	uint32_t h;
+
+	memset(table, 0, sizeof(table));
+
+	while (ip < limit)
+	{
+		h = hash(ip);
+		ref = table[h] ? in + table[h] - 1 : NULL;
+		table[h] = (uint32_t)(ip - in) + 1;
+
+		if (ref == NULL || ip - ref > MAX_OFFSET ||
+			memcmp(ref, ip, MIN_MATCH) != 0)
+		{
+			ip++;
+			continue;
+		}
+
+		for (mlen = MIN_MATCH; ip + mlen < end && ref[mlen] == ip[mlen]; mlen++)
+			;
+
+		op = putPair(op, oend, anchor, ip - anchor, ip - ref, mlen);
+
+		if (op == NULL)
+		{
+			return 0;
+		}
+
+		ip += mlen;
+		anchor = ip;
+	}
+
+	op = putPair(op, oend, anchor, end - anchor, 0, 0);
+
+	if (op == NULL)
+	{
+		return 0;
+	}
+
+	return op - (uint8_t *)dst;
+}
+
+/* Read the extra bytes of a length whose nibble overflowed */
+static const uint8_t *getLength(const uint8_t *ip, const uint8_t *iend,
+								size_t *n)
+{
+	uint8_t b;
+
+	do
+	{
+		if (ip == iend)
+		{
+			return NULL;
+		}
+
+		b = *ip++;
+		*n += b;
+	} while (b == 255);
+
+	return ip;
+}
+
+long lzDecompress(const void *src, size_t len, void *dst, size_t cap)
+{
+	const uint8_t *ip = src, *iend = ip + len;
+	uint8_t *out = dst, *op = out, *oend = out + cap;
+	size_t nlit, mlen, offset;
+	uint8_t token;
+
+	while (ip < iend)
+	{
+		token = *ip++;
+		nlit = token >> 4;
+		mlen = (token & 15) + MIN_MATCH;
+
+		if (nlit == 15 && (ip = getLength(ip, iend, &nlit)) == NULL)
+		{
+			return -1;
+		}
+
+		if ((size_t)(iend - ip) < nlit || (size_t)(oend - op) < nlit)
+		{
+			return -1;
+		}
+
+		memcpy(op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+
+		if (ip == iend)
+		{
+			break; /* last pair */
+		}
+
+		if (iend - ip < 2)
+		{
+			return -1;
+		}
+
+		offset = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+
+		if ((token & 15) == 15 && (ip = getLength(ip, iend, &mlen)) == NULL)
+		{
+			return -1;
+		}
+
+		if (offset == 0 || offset > (size_t)(op - out) ||
+			(size_t)(oend - op) < mlen)
+		{
+			return -1;
+		}
+
+		/* byte by byte, the match may overlap what it produces */
+		for (; mlen > 0; mlen--, op++)
+		{
+			*op = *(op - offset);
+		}
+	}
+
+	return op - out;
+}
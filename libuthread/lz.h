@@ -0,0 +1,29 @@
+#ifndef _LZ_H
+#define _LZ_H
+
+#include <stddef.h>
+
+/*
+ * Fast LZ77-style codec, for internal use by the library
+ *
+ * The compressed format is a sequence of (literals, match) pairs: a token byte
+ * holding the number of literals in its high nibble and the match length minus
+ * 4 in its low nibble (a nibble of 15 being followed by extra length bytes,
+ * each adding up to 255), the literals themselves, then the match as a 2-byte
+ * little-endian offset back into the output. The last pair has no match.
+ */
+
+/*
+ * Compress the @len bytes at @src into @dst, which can hold @cap bytes. Return
+ * the compressed size, or 0 if it would exceed @cap.
+ */
+size_t lzCompress(const void *src, size_t len, void *dst, size_t cap);
+
+/*
+ * Decompress the @len bytes at @src into @dst, which can hold @cap bytes.
+ * Return the decompressed size, or -1 if @src is corrupted or decompresses to
+ * more than @cap bytes.
+ */
+long lzDecompress(const void *src, size_t len, void *dst, size_t cap);
+
+#endif /* _LZ_H */
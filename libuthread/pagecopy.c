@@ -0,0 +1,121 @@
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+#include "pagecopy.h"
+
+typedef void (*kernel_t)(void *dst, const void *src);
+
+static kernel_t copyKernel;
+static pthread_once_t selectOnce = PTHREAD_ONCE_INIT;
+
+static void copyLibc(void *dst, const void *src)
+{
+	memcpy(dst, src, TPS_SIZE);
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("sse2"))) static void copySse2(void *dst,
+													 const void *src)
+{
+	const __m128i *s = src;
+	__m128i *d = dst;
+	__m128i a, b, c, e;
+	size_t i;
+
+	for (i = 0; i < TPS_SIZE / sizeof(__m128i); i += 4)
+	{
+		a = _mm_loadu_si128(s + i);
+		b = _mm_loadu_si128(s + i + 1);
+		c = _mm_loadu_si128(s + i + 2);
+		e = _mm_loadu_si128(s + i + 3);
+		_mm_storeu_si128(d + i, a);
+		_mm_storeu_si128(d + i + 1, b);
+		_mm_storeu_si128(d + i + 2, c);
+		_mm_storeu_si128(d + i + 3, e);
+	}
+}
+
+__attribute__((target("avx2"))) static void copyAvx2(void *dst,
+													 const void *src)
+{
+	const __m256i *s = src;
+	__m256i *d = dst;
+	__m256i a, b, c, e;
+	size_t i;
+
+	for (i = 0; i < TPS_SIZE / sizeof(__m256i); i += 4)
+	{
+		a = _mm256_loadu_si256(s + i);
+		b = _mm256_loadu_si256(s + i + 1);
+		c = _mm256_loadu_si256(s + i + 2);
+		e = _mm256_loadu_si256(s + i + 3);
+		_mm256_storeu_si256(d + i, a);
+		_mm256_storeu_si256(d + i + 1, b);
+		_mm256_storeu_si256(d + i + 2, c);
+		_mm256_storeu_si256(d + i + 3, e);
+	}
+}
+#endif
+
+/* Use the kernels of instruction set @isa if the cpu supports it */
+static int useKernels(const char *isa)
+{
+	kernel_t copy = NULL;
+
+	if (strcmp(isa, "libc") == 0)
+	{
+		copy = copyLibc;
+	}
+#ifdef HAVE_X86_KERNELS
+	else if (strcmp(isa, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+	{
+		copy = copySse2;
+	}
+	else if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2"))
+	{
+		copy = copyAvx2;
+	}
+#endif
+
+	if (copy == NULL)
+	{
+		return -1;
+	}
+
+	__atomic_store_n(&copyKernel, copy, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+static void selectBest(void)
+{
+	if (useKernels("avx2") == -1 && useKernels("sse2") == -1)
+	{
+		useKernels("libc");
+	}
+}
+
+int pageCopySelect(const char *isa)
+{
+	pthread_once(&selectOnce, selectBest);
+
+	if (isa == NULL)
+	{
+		selectBest();
+		return 0;
+	}
+
+	return useKernels(isa);
+}
+
+void pageCopy(void *dst, const void *src)
+{
+	pthread_once(&selectOnce, selectBest);
+
+	__atomic_load_n(&copyKernel, __ATOMIC_RELAXED)(dst, src);
+}
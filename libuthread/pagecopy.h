@@ -0,0 +1,23 @@
+#ifndef _PAGECOPY_H
+#define _PAGECOPY_H
+
+#include "tps.h"
+
+/*
+ * Copy kernels for whole TPS areas, for internal use by the library
+ *
+ * The widest vector instructions supported by the cpu are selected at run
+ * time. Copies happen within the critical section.
+ */
+
+/* Copy TPS_SIZE bytes from @src to @dst */
+void pageCopy(void *dst, const void *src);
+
+/*
+ * Force the kernels to use instruction set @isa ("libc", "sse2" or "avx2"),
+ * or the best one available if @isa is NULL. Return -1 if @isa is unknown or
+ * not supported by the cpu, 0 otherwise. Meant for benchmarks.
+ */
+int pageCopySelect(const char *isa);
+
+#endif /* _PAGECOPY_H */
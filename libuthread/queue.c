@@ -0,0 +1,344 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "queue.h"
+
+/*
+ * Items are kept in a circular array whose capacity is a power of two, so that
+ * enqueueing and dequeueing only allocate when the queue outgrows its storage,
+ * and iterating walks contiguous memory. The storage is allocated on the first
+ * enqueue, since many queues (e.g. the per-priority wait lists of semaphores)
+ * never hold anything.
+ *
+ * Positions in the array are counted from the creation of the queue and only
+ * reduced modulo the capacity when accessing it. Deleting an item from the
+ * middle leaves a tombstone (a NULL item) in its slot, skipped by the other
+ * operations and reclaimed once it reaches either end of the queue, or when
+ * the array gets full with at least as many tombstones as items, in which case
+ * the items are packed toward the head instead of growing the array.
+ *
+ * Since items move when packed, handles designate a reference, which follows
+ * the position of its item. References are kept in a second array, with the
+ * same capacity, and recycled through a free list. Each reference carries a
+ * generation, bumped whenever it is freed, so that a handle on an item already
+ * removed from the queue is recognized as stale even if its reference has
+ * since been reused.
+ */
+#define QUEUE_MIN_CAPACITY 8
+#define NONE UINT32_MAX
+
+struct slot
+{
+	void *_data;  /* NULL for a tombstone */
+	uint32_t _ref; /* reference of the item */
+};
+
+struct ref
+{
+	uint32_t _pos; /* position of the item; next free reference */
+	uint32_t _gen; /* generation, for handles */
+};
+
+typedef struct queue
+{
+	struct slot *_slots; /* circular array of items */
+	struct ref *_refs;	 /* references of the items */
+	uint32_t _mask;		 /* capacity - 1 */
+	uint32_t _head;		 /* position of the oldest item */
+	uint32_t _tail;		 /* position following the newest item */
+	uint32_t _length;	 /* number of items, tombstones excluded */
+	uint32_t _refsUsed;	 /* references used at least once */
+	uint32_t _freeRef;	 /* list of free references */
+	uint32_t _moves;	 /* bumped whenever items move */
+} queue;
+
+#define HANDLE(queue, r) ((queue_handle_t)(queue)->_refs[r]._gen << 32 | (r))
+
+/* Slot of the item at position @pos */
+static inline struct slot *at(queue_t queue, uint32_t pos)
+{
+	return &queue->_slots[pos & queue->_mask];
+}
+
+/*
+ * Make room for one more item in the full array of @queue, by packing its
+ * items if it holds enough tombstones, by doubling its capacity otherwise
+ */
+static int makeRoom(queue_t queue)
+{
+	uint32_t capacity = queue->_slots == NULL ? 0 : queue->_mask + 1;
+	uint32_t newCapacity = capacity;
+	struct slot *slots = queue->_slots;
+	struct ref *refs;
+	uint32_t pos, to;
+
+	if (capacity == 0 || queue->_length > capacity / 2)
+	{
+		newCapacity = capacity == 0 ? QUEUE_MIN_CAPACITY : capacity * 2;
+
+		if (newCapacity <= capacity || newCapacity == NONE ||
+			newCapacity > SIZE_MAX / sizeof(struct slot))
+		{
+			return -1;
+		}
+
+		refs = realloc(queue->_refs, newCapacity * sizeof(struct ref));
+
+		if (refs == NULL)
+		{
+			return -1;
+		}
+
+		queue->_refs = refs;
+		slots = malloc(newCapacity * sizeof(struct slot));
+
+		if (slots == NULL)
+		{
+			return -1;
+		}
+	}
+
+	/*
+	 * Items only move toward the head, in order, so packing within the same
+	 * array never overwrites an item yet to be moved
+	 */
+	for (pos = to = queue->_head; pos != queue->_tail; pos++)
+	{
+		struct slot item = *at(queue, pos);
+
+		if (item._data != NULL)
+		{
+			slots[to & (newCapacity - 1)] = item;
+			queue->_refs[item._ref]._pos = to++;
+		}
+	}
+
+	if (slots != queue->_slots)
+	{
+		free(queue->_slots);
+		queue->_slots = slots;
+		queue->_mask = newCapacity - 1;
+	}
+
+	queue->_tail = to;
+	queue->_moves++;
+
+	return 0;
+}
+
+/* Give reference @r back to the free list */
+static void freeRef(queue_t queue, uint32_t r)
+{
+	queue->_refs[r]._gen++;
+	queue->_refs[r]._pos = queue->_freeRef;
+	queue->_freeRef = r;
+}
+
+/* Turn the item at position @pos into a tombstone, reclaiming the ends */
+static void removeAt(queue_t queue, uint32_t pos)
+{
+	struct slot *slot = at(queue, pos);
+
+	freeRef(queue, slot->_ref);
+	slot->_data = NULL;
+	queue->_length--;
+
+	while (queue->_head != queue->_tail &&
+		   at(queue, queue->_head)->_data == NULL)
+	{
+		queue->_head++;
+	}
+
+	while (queue->_tail != queue->_head &&
+		   at(queue, queue->_tail - 1)->_data == NULL)
+	{
+		queue->_tail--;
+	}
+}
+
+queue_t queue_create(void)
+{
+	queue_t queue = malloc(sizeof(struct queue));
+
+	if (queue == NULL)
+	{
+		return NULL;
+	}
+
+	queue->_slots = NULL;
+	queue->_refs = NULL;
+	queue->_mask = 0;
+	queue->_head = 0;
+	queue->_tail = 0;
+	queue->_length = 0;
+	queue->_refsUsed = 0;
+	queue->_freeRef = NONE;
+	queue->_moves = 0;
+
+	return queue;
+}
+
+int queue_destroy(queue_t queue)
+{
+	if (queue == NULL || queue->_length > 0)
+	{
+		return -1;
+	}
+
+	free(queue->_slots);
+	free(queue->_refs);
+	free(queue);
+
+	return 0;
+}
+
+int queue_enqueue_handle(queue_t queue, void *data, queue_handle_t *handle)
+{
+	struct slot *slot;
+	uint32_t r;
+
+	if (queue == NULL || data == NULL)
+	{
+		return -1;
+	}
+
+	if (queue->_slots == NULL ||
+		queue->_tail - queue->_head == queue->_mask + 1)
+	{
+		if (makeRoom(queue) == -1)
+		{
+			return -1;
+		}
+	}
+
+	/* there are never more references in use than items */
+	if (queue->_freeRef != NONE)
+	{
+		r = queue->_freeRef;
+		queue->_freeRef = queue->_refs[r]._pos;
+	}
+	else
+	{
+		r = queue->_refsUsed++;
+		queue->_refs[r]._gen = 0;
+	}
+
+	slot = at(queue, queue->_tail);
+	slot->_data = data;
+	slot->_ref = r;
+	queue->_refs[r]._pos = queue->_tail++;
+	queue->_length++;
+
+	if (handle != NULL)
+	{
+		*handle = HANDLE(queue, r);
+	}
+
+	return 0;
+}
+
+int queue_enqueue(queue_t queue, void *data)
+{
+	return queue_enqueue_handle(queue, data, NULL);
+}
+
+int queue_dequeue(queue_t queue, void **data)
+{
+	if (queue == NULL || data == NULL || queue->_length == 0)
+	{
+		return -1;
+	}
+
+	/* the head is never a tombstone */
+	*data = at(queue, queue->_head)->_data;
+	removeAt(queue, queue->_head);
+
+	return 0;
+}
+
+int queue_delete(queue_t queue, void *data)
+{
+	uint32_t pos;
+
+	if (queue == NULL || data == NULL)
+	{
+		return -1;
+	}
+
+	for (pos = queue->_head; pos != queue->_tail; pos++)
+	{
+		if (at(queue, pos)->_data == data)
+		{
+			removeAt(queue, pos);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int queue_delete_handle(queue_t queue, queue_handle_t handle)
+{
+	uint32_t r = (uint32_t)handle;
+
+	/* freed references are a generation ahead of their handles */
+	if (queue == NULL || r >= queue->_refsUsed || HANDLE(queue, r) != handle)
+	{
+		return -1;
+	}
+
+	removeAt(queue, queue->_refs[r]._pos);
+
+	return 0;
+}
+
+int queue_iterate(queue_t queue, queue_func_t func, void *arg, void **data)
+{
+	struct slot item;
+	uint32_t pos, moves;
+
+	if (queue == NULL || func == NULL)
+	{
+		return -1;
+	}
+
+	for (pos = queue->_head; pos != queue->_tail; pos++)
+	{
+		item = *at(queue, pos);
+
+		if (item._data == NULL)
+		{
+			continue;
+		}
+
+		moves = queue->_moves;
+
+		if (func(item._data, arg) == 1)
+		{
+			if (data != NULL)
+			{
+				*data = item._data;
+			}
+
+			break;
+		}
+
+		/* @func may have enqueued or deleted other items, moving this one */
+		if (queue->_moves != moves)
+		{
+			pos = queue->_refs[item._ref]._pos;
+		}
+	}
+
+	return 0;
+}
+
+int queue_length(queue_t queue)
+{
+	if (queue == NULL)
+	{
+		return -1;
+	}
+
+	return queue->_length;
+}
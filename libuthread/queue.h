@@ -1,6 +1,8 @@
 #ifndef _QUEUE_H
 #define _QUEUE_H
 
+#include <stdint.h>
+
 /*
  * queue_t - Queue type
  *
@@ -9,9 +11,21 @@
  * first and so on.
  *
  * Apart from delete and iterate operations, all operations should be O(1).
+ * Items are stored contiguously, in an array that only grows when the queue
+ * outgrows it, so that enqueueing and dequeueing do not allocate memory in the
+ * steady state.
  */
 typedef struct queue* queue_t;
 
+/*
+ * queue_handle_t - Queue item handle
+ *
+ * A handle designates an item in a queue, from its enqueueing until it leaves
+ * the queue (i.e. until it is dequeued or deleted), and allows deleting this
+ * item in O(1).
+ */
+typedef uint64_t queue_handle_t;
+
 /*
  * queue_create - Allocate an empty queue
  *
@@ -45,6 +59,21 @@ int queue_destroy(queue_t queue);
  */
 int queue_enqueue(queue_t queue, void *data);
 
+/*
+ * queue_enqueue_handle - Enqueue data item and get its handle
+ * @queue: Queue in which to enqueue item
+ * @data: Address of data item to enqueue
+ * @handle: (Optional) Address of handle where the enqueued item is received
+ *
+ * Enqueue the address contained in @data in the queue @queue, like
+ * queue_enqueue(), and if @handle is different than NULL, assign the handle of
+ * the new item to @handle.
+ *
+ * Return: -1 if @queue or @data are NULL, or in case of memory allocation error
+ * when enqueing. 0 if @data was successfully enqueued in @queue.
+ */
+int queue_enqueue_handle(queue_t queue, void *data, queue_handle_t *handle);
+
 /*
  * queue_dequeue - Dequeue data item
  * @queue: Queue in which to dequeue item
@@ -71,6 +100,19 @@ int queue_dequeue(queue_t queue, void **data);
  */
 int queue_delete(queue_t queue, void *data);
 
+/*
+ * queue_delete_handle - Delete data item by handle
+ * @queue: Queue in which to delete item
+ * @handle: Handle of the item to delete
+ *
+ * Delete the item of queue @queue designated by @handle, in O(1).
+ *
+ * Return: -1 if @queue is NULL, or if @handle does not designate an item of
+ * @queue (e.g. because the item already left the queue). 0 if the item was
+ * found and deleted from @queue.
+ */
+int queue_delete_handle(queue_t queue, queue_handle_t handle);
+
 /*
  * queue_func_t - Queue callback function type
  * @data: Data item
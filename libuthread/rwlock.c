@@ -0,0 +1,317 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "queue.h"
+#include "rwlock.h"
+#include "thread.h"
+
+/*
+ * State word of the lock: number of readers holding the lock in the low bits,
+ * plus flags. The waiting flags are only set within the critical section,
+ * along with the queueing of the corresponding thread, so that releasing the
+ * lock goes through the slow path as soon as someone has to be woken up.
+ */
+#define WRITER ((uint32_t)1 << 31)			/* held by a writer */
+#define WRITERS_WAITING ((uint32_t)1 << 30) /* writers are blocked */
+#define READERS_WAITING ((uint32_t)1 << 29) /* readers are blocked */
+#define READERS_MASK (READERS_WAITING - 1)
+
+struct rwlock
+{
+	uint32_t _state;
+	queue_t _readers; /* blocked readers */
+	queue_t _writers; /* blocked writers */
+} rwlock;
+
+/* A blocked thread, living on its stack */
+struct rwWaiter
+{
+	pthread_t _tid;
+	int _granted; /* set when the lock was handed over to the thread */
+};
+
+/* add @flag to the state of @lock, in the critical section */
+static void setFlag(rwlock_t lock, uint32_t flag)
+{
+	__atomic_fetch_or(&lock->_state, flag, __ATOMIC_SEQ_CST);
+}
+
+/* block the caller until the lock is handed over, in the critical section */
+static void waitGranted(queue_t queue)
+{
+	struct rwWaiter w;
+
+	w._tid = pthread_self();
+	w._granted = 0;
+
+	queue_enqueue(queue, &w);
+
+	while (!w._granted)
+	{
+		thread_block();
+	}
+}
+
+/* hand the lock over to waiter @w, in the critical section */
+static void grant(struct rwWaiter *w)
+{
+	w->_granted = 1;
+	thread_unblock(w->_tid);
+}
+
+/*
+ * Hand the lock over to the next writer, the lock being free. Must be called
+ * within the critical section, with at least one writer blocked.
+ */
+static void grantWriter(rwlock_t lock, uint32_t state)
+{
+	struct rwWaiter *w;
+
+	queue_dequeue(lock->_writers, (void **)&w);
+
+	state = (state & READERS_WAITING) | WRITER;
+
+	if (queue_length(lock->_writers) > 0)
+	{
+		state |= WRITERS_WAITING;
+	}
+
+	__atomic_store_n(&lock->_state, state, __ATOMIC_SEQ_CST);
+	grant(w);
+}
+
+rwlock_t rwlock_create(void)
+{
+	rwlock_t lock = malloc(sizeof(rwlock));
+
+	if (lock == NULL)
+	{
+		return NULL;
+	}
+
+	lock->_state = 0;
+	lock->_readers = queue_create();
+	lock->_writers = queue_create();
+
+	if (lock->_readers == NULL || lock->_writers == NULL)
+	{
+		queue_destroy(lock->_readers);
+		queue_destroy(lock->_writers);
+		free(lock);
+		return NULL;
+	}
+
+	return lock;
+}
+
+int rwlock_destroy(rwlock_t lock)
+{
+	if (lock == NULL || lock->_state != 0)
+	{
+		return -1;
+	}
+
+	queue_destroy(lock->_readers);
+	queue_destroy(lock->_writers);
+	free(lock);
+
+	return 0;
+}
+
+int rwlock_tryrdlock(rwlock_t lock)
+{
+	if (lock == NULL)
+	{
+		return -1;
+	}
+
+	uint32_t state = __atomic_load_n(&lock->_state, __ATOMIC_RELAXED);
+
+	while (!(state & (WRITER | WRITERS_WAITING)))
+	{
+		if (__atomic_compare_exchange_n(&lock->_state, &state, state + 1, 1,
+										__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int rwlock_rdlock(rwlock_t lock)
+{
+	if (lock == NULL)
+	{
+		return -1;
+	}
+
+	if (rwlock_tryrdlock(lock) == 0)
+	{
+		return 0; /* fast path */
+	}
+
+	enter_critical_section();
+
+	setFlag(lock, READERS_WAITING);
+
+	/* the writers may have left before seeing the flag */
+	if (rwlock_tryrdlock(lock) == 0)
+	{
+		if (queue_length(lock->_readers) == 0)
+		{
+			__atomic_fetch_and(&lock->_state, ~READERS_WAITING,
+							   __ATOMIC_RELAXED);
+		}
+
+		exit_critical_section();
+		return 0;
+	}
+
+	waitGranted(lock->_readers);
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int rwlock_trywrlock(rwlock_t lock)
+{
+	uint32_t state = 0;
+
+	if (lock == NULL)
+	{
+		return -1;
+	}
+
+	if (__atomic_compare_exchange_n(&lock->_state, &state, WRITER, 0,
+									__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		return 0;
+	}
+
+	return -1;
+}
+
+int rwlock_wrlock(rwlock_t lock)
+{
+	if (lock == NULL)
+	{
+		return -1;
+	}
+
+	if (rwlock_trywrlock(lock) == 0)
+	{
+		return 0; /* fast path */
+	}
+
+	enter_critical_section();
+
+	setFlag(lock, WRITERS_WAITING);
+
+	uint32_t state = __atomic_load_n(&lock->_state, __ATOMIC_SEQ_CST);
+
+	/* the holders may have left before seeing the flag */
+	if (!(state & (WRITER | READERS_MASK)))
+	{
+		if (queue_length(lock->_writers) == 0)
+		{
+			state &= ~WRITERS_WAITING;
+		}
+
+		__atomic_store_n(&lock->_state, state | WRITER, __ATOMIC_SEQ_CST);
+
+		exit_critical_section();
+		return 0;
+	}
+
+	waitGranted(lock->_writers);
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int rwlock_unlock(rwlock_t lock)
+{
+	if (lock == NULL)
+	{
+		return -1;
+	}
+
+	uint32_t state = __atomic_load_n(&lock->_state, __ATOMIC_RELAXED);
+
+	if (state & WRITER)
+	{
+		/* fast path: nobody is waiting */
+		if (state == WRITER &&
+			__atomic_compare_exchange_n(&lock->_state, &state, 0, 0,
+										__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		{
+			return 0;
+		}
+
+		enter_critical_section();
+
+		state = __atomic_load_n(&lock->_state, __ATOMIC_SEQ_CST);
+
+		if (state & READERS_WAITING)
+		{
+			/* let all the blocked readers in, writers wait for them */
+			struct rwWaiter *w;
+			uint32_t readers = queue_length(lock->_readers);
+
+			state = readers & READERS_MASK;
+
+			if (queue_length(lock->_writers) > 0)
+			{
+				state |= WRITERS_WAITING;
+			}
+
+			__atomic_store_n(&lock->_state, state, __ATOMIC_SEQ_CST);
+
+			while (queue_dequeue(lock->_readers, (void **)&w) == 0)
+			{
+				grant(w);
+			}
+		}
+		else if (state & WRITERS_WAITING)
+		{
+			grantWriter(lock, state);
+		}
+		else
+		{
+			__atomic_store_n(&lock->_state, 0, __ATOMIC_SEQ_CST);
+		}
+
+		exit_critical_section();
+
+		return 0;
+	}
+
+	if ((state & READERS_MASK) == 0)
+	{
+		return -1; /* not held */
+	}
+
+	state = __atomic_sub_fetch(&lock->_state, 1, __ATOMIC_RELEASE);
+
+	if ((state & READERS_MASK) == 0 && (state & WRITERS_WAITING))
+	{
+		/* last reader out, the lock goes to the next writer */
+		enter_critical_section();
+
+		state = __atomic_load_n(&lock->_state, __ATOMIC_SEQ_CST);
+
+		if (!(state & (WRITER | READERS_MASK)) &&
+			queue_length(lock->_writers) > 0)
+		{
+			grantWriter(lock, state);
+		}
+
+		exit_critical_section();
+	}
+
+	return 0;
+}
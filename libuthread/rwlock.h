@@ -0,0 +1,90 @@
+#ifndef _RWLOCK_H
+#define _RWLOCK_H
+
+/*
+ * rwlock_t - Reader-writer lock type
+ *
+ * A reader-writer lock protects a resource that can be read by several threads
+ * at once but only modified by a single thread at a time. Taking and releasing
+ * an uncontended lock is a single atomic operation, without entering the
+ * critical section.
+ *
+ * The lock prefers writers: as soon as a writer is waiting, new readers are
+ * blocked so that the writer gets the lock once the current readers are done.
+ * When a writer releases the lock, all the readers blocked at that time are
+ * let in first, which prevents a stream of writers from starving readers.
+ */
+typedef struct rwlock *rwlock_t;
+
+/*
+ * rwlock_create - Create reader-writer lock
+ *
+ * Allocate and initialize an unlocked reader-writer lock.
+ *
+ * Return: Pointer to initialized lock. NULL in case of failure when allocating
+ * the new lock.
+ */
+rwlock_t rwlock_create(void);
+
+/*
+ * rwlock_destroy - Deallocate a reader-writer lock
+ * @lock: Lock to deallocate
+ *
+ * Return: -1 if @lock is NULL, or if @lock is held or other threads are still
+ * being blocked on @lock. 0 if @lock was successfully destroyed.
+ */
+int rwlock_destroy(rwlock_t lock);
+
+/*
+ * rwlock_rdlock - Take a reader-writer lock for reading
+ * @lock: Lock to take
+ *
+ * Take lock @lock in shared mode, blocking the caller thread while a writer
+ * holds the lock or is waiting for it.
+ *
+ * Return: -1 if @lock is NULL. 0 if @lock was successfully taken.
+ */
+int rwlock_rdlock(rwlock_t lock);
+
+/*
+ * rwlock_tryrdlock - Take a reader-writer lock for reading without blocking
+ * @lock: Lock to take
+ *
+ * Return: -1 if @lock is NULL, or if a writer holds the lock or is waiting for
+ * it. 0 if @lock was successfully taken.
+ */
+int rwlock_tryrdlock(rwlock_t lock);
+
+/*
+ * rwlock_wrlock - Take a reader-writer lock for writing
+ * @lock: Lock to take
+ *
+ * Take lock @lock in exclusive mode, blocking the caller thread while other
+ * threads hold the lock.
+ *
+ * Return: -1 if @lock is NULL. 0 if @lock was successfully taken.
+ */
+int rwlock_wrlock(rwlock_t lock);
+
+/*
+ * rwlock_trywrlock - Take a reader-writer lock for writing without blocking
+ * @lock: Lock to take
+ *
+ * Return: -1 if @lock is NULL or held by another thread. 0 if @lock was
+ * successfully taken.
+ */
+int rwlock_trywrlock(rwlock_t lock);
+
+/*
+ * rwlock_unlock - Release a reader-writer lock
+ * @lock: Lock to release
+ *
+ * Release lock @lock, held by the caller thread either for reading or for
+ * writing, and unblock the threads that can take it next if any.
+ *
+ * Return: -1 if @lock is NULL or not held. 0 if @lock was successfully
+ * released.
+ */
+int rwlock_unlock(rwlock_t lock);
+
+#endif /* _RWLOCK_H */
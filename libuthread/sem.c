@@ -1,32 +1,862 @@
+#define _GNU_SOURCE
+#include <sched.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "queue.h"
 #include "sem.h"
+#include "sem_cond.h"
+#include "sem_shared.h"
 #include "thread.h"
+#include "topo.h"
+#include "trace_probe.h"
+#include "uthread_sched.h"
+
+/* bounds of the adaptive spin budget, in nanoseconds */
+#define SEM_SPIN_MIN_NS 1000
+#define SEM_SPIN_MAX_NS 20000
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __sync_synchronize()
+#endif
+
+/* one queue of blocked threads per waiting priority */
+#define SEM_PRIO_LEVELS (SEM_PRIO_MAX + 1)
 
 struct semaphore
 {
 	size_t _count;			/* internal count */
-	queue_t _blockingQueue; /* queue of tids of blocked pthreads */
+	queue_t _blockingQueues[SEM_PRIO_LEVELS]; /* waiters, see struct waiter */
+	uint32_t _prioMask;		/* priorities having blocked pthreads */
+	int _blocked;			/* number of blocked pthreads */
+	sem_policy_t _policy;	/* how released resources reach waiters */
+	int _adaptive;			/* spin before going to sleep */
+	int _wakeAffine;		/* run woken uthreads next to their waker */
+	uint64_t _waitAvg;		/* running average of wait times (ns) */
+	int _eventFd;			/* readable while resources are available */
+	struct sharedSem *_shared; /* process-shared state, NULL if private */
+	char *_name;			/* optional, for statistics */
+	sem_executor_t _executor; /* runs continuations, NULL if their releaser */
+	void *_executorData;	/* argument of _executor */
+#ifdef SEM_STATS
+	struct sem_stats _stats;
+	queue_handle_t _live; /* entry in the list of all semaphores */
+#endif
 } semaphore;
 
-sem_t sem_create(size_t count)
+static int multicore = -1; /* spinning only pays off with several cpus */
+
+/*
+ * Statistics are only collected when the library is built with SEM_STATS
+ * defined, otherwise the probes below compile to nothing. They are updated
+ * within the critical section.
+ */
+#ifdef SEM_STATS
+static queue_t liveSems; /* all existing semaphores */
+
+#define STAT_ADD(sem, field, n) ((sem)->_stats.field += (n))
+#define STAT_MAX(sem, field, v)           \
+	do                                    \
+	{                                     \
+		if ((v) > (sem)->_stats.field)    \
+		{                                 \
+			(sem)->_stats.field = (v);    \
+		}                                 \
+	} while (0)
+#define STAT_NOW() now()
+#define STAT_WAIT(sem, since) statWait(sem, since)
+#else
+#define STAT_ADD(sem, field, n) ((void)0)
+#define STAT_MAX(sem, field, v) ((void)0)
+#define STAT_NOW() 0
+#define STAT_WAIT(sem, since) ((void)(since))
+#endif
+
+static uint64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef SEM_STATS
+/* account for a thread that blocked on @sem since @since and got a resource */
+static void statWait(sem_t sem, uint64_t since)
+{
+	uint64_t wait = now() - since;
+	unsigned int bucket = 63 - __builtin_clzll(wait | 1);
+
+	if (bucket >= SEM_STATS_BUCKETS)
+	{
+		bucket = SEM_STATS_BUCKETS - 1;
+	}
+
+	sem->_stats.blocking_downs++;
+	sem->_stats.wait_total_ns += wait;
+	sem->_stats.wait_hist[bucket]++;
+	STAT_MAX(sem, wait_max_ns, wait);
+}
+#endif
+
+/* fold an observed wait into the running average of @sem (weight 1/8) */
+static void recordWait(sem_t sem, uint64_t wait)
+{
+	uint64_t avg = __atomic_load_n(&sem->_waitAvg, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&sem->_waitAvg, avg - avg / 8 + wait / 8,
+					 __ATOMIC_RELAXED);
+}
+
+/*
+ * The eventfd of a semaphore, when requested, holds a single token while the
+ * count is not zero. It is only written to when the count goes from zero to
+ * one and read from when the count goes back to zero, so that bursts of
+ * operations on an available semaphore do not cost any system call.
+ */
+
+/* take a resource out of the count of @sem, in the critical section */
+static void takeResource(sem_t sem)
+{
+	uint64_t token;
+
+	STAT_ADD(sem, downs, 1);
+
+	if (--sem->_count == 0 && sem->_eventFd != -1)
+	{
+		read(sem->_eventFd, &token, sizeof(token));
+	}
+}
+
+/* put a resource back into the count of @sem, in the critical section */
+static void giveResource(sem_t sem)
+{
+	uint64_t token = 1;
+
+	if (sem->_count++ == 0 && sem->_eventFd != -1)
+	{
+		write(sem->_eventFd, &token, sizeof(token));
+	}
+}
+
+/*
+ * Poll the count of @sem for a bounded amount of time, trying to take a
+ * resource without going to sleep. The budget is twice the average wait
+ * recently observed on @sem: when waits are typically longer than what
+ * spinning can cover, only a short probe is made before going to sleep.
+ */
+static int spinDown(sem_t sem, uint64_t start)
+{
+	uint64_t budget = 2 * __atomic_load_n(&sem->_waitAvg, __ATOMIC_RELAXED);
+	unsigned int i;
+
+	if (budget > 2 * SEM_SPIN_MAX_NS)
+	{
+		budget = SEM_SPIN_MIN_NS;
+	}
+	else if (budget > SEM_SPIN_MAX_NS)
+	{
+		budget = SEM_SPIN_MAX_NS;
+	}
+	else if (budget < SEM_SPIN_MIN_NS)
+	{
+		budget = SEM_SPIN_MIN_NS;
+	}
+
+	for (i = 1;; i++)
+	{
+		if (__atomic_load_n(&sem->_count, __ATOMIC_RELAXED) > 0)
+		{
+			enter_critical_section();
+
+			if (sem->_count > 0)
+			{
+				takeResource(sem);
+				exit_critical_section();
+				recordWait(sem, now() - start);
+				return 1;
+			}
+
+			exit_critical_section();
+		}
+
+		cpu_relax();
+
+		/* reading the clock is not free, only do it once in a while */
+		if (i % 16 == 0 && now() - start > budget)
+		{
+			return 0;
+		}
+	}
+}
+
+/*
+ * A blocked thread, registered in the waiting list of one or several
+ * semaphores. Lives on the stack of the thread while it is blocked.
+ */
+struct waiter
+{
+	pthread_t _tid;
+	uthread_t _uthread; /* NULL if not a uthread */
+	unsigned int _prio; /* waiting priority */
+	sem_t *_sems;		/* semaphores the thread is waiting on */
+	queue_handle_t *_handles; /* its entries in their waiting lists */
+	size_t _count;		/* number of such semaphores */
+	sem_t _wokenBy;		/* semaphore that woke the thread up */
+	int _cpu;			/* cpu the thread last ran on */
+	int _granted;		/* resource handed over before waking the thread */
+	uint64_t _since;	/* start of the wait of an adaptive down, or 0 */
+	uint64_t _blockedAt; /* for statistics */
+	sem_callback_t _callback; /* NULL if a blocked thread */
+	void *_arg;			/* argument of _callback */
+	struct waiter *_nextCompleted; /* in a list of completed takes */
+};
+
+/*
+ * A pending asynchronous take, allocated until its continuation is run. The
+ * waiter goes first for the allocation to be freed through it.
+ */
+struct asyncWaiter
+{
+	struct waiter _waiter;
+	sem_t _sem;
+	queue_handle_t _handle;
+};
+
+/*
+ * Asynchronous takes handed a resource by the calling thread, whose
+ * continuation is yet to be run out of the critical section
+ */
+static __thread struct waiter *completedHead, *completedTail;
+
+/* whether the calling thread is running continuations */
+static __thread int runningCompletions;
+
+/*
+ * Asynchronous takes handed a lock by cond_wait(), whose caller cannot run
+ * their continuation since it blocks. They are run by a dedicated thread,
+ * only started when the first of them is deferred. Protected by the critical
+ * section.
+ */
+static struct waiter *deferredHead, *deferredTail;
+static pthread_t completer;
+static int completerStarted;
+static int completerIdle; /* whether it is blocked, waiting for work */
+
+/*
+ * Queue waiter @w behind the blocked threads of same priority, @handle
+ * receiving its entry in the waiting list.
+ */
+static int enqueueWaiter(sem_t sem, struct waiter *w, queue_handle_t *handle)
+{
+	queue_t *queue = &sem->_blockingQueues[w->_prio];
+
+	if (*queue == NULL)
+	{
+		*queue = queue_create(); /* first waiter at this priority */
+
+		if (*queue == NULL)
+		{
+			return -1;
+		}
+	}
+
+	if (queue_enqueue_handle(*queue, w, handle) == -1)
+	{
+		return -1;
+	}
+
+	sem->_prioMask |= (uint32_t)1 << w->_prio;
+	sem->_blocked++;
+	STAT_MAX(sem, max_blocked, sem->_blocked);
+
+	return 0;
+}
+
+/* remove the oldest blocked thread among those of highest priority */
+static struct waiter *dequeueWaiter(sem_t sem)
+{
+	struct waiter *w = NULL;
+
+	if (sem->_prioMask == 0)
+	{
+		return NULL;
+	}
+
+	unsigned int prio = 31 - __builtin_clz(sem->_prioMask);
+	queue_t queue = sem->_blockingQueues[prio];
+
+	queue_dequeue(queue, (void **)&w);
+
+	if (queue_length(queue) == 0)
+	{
+		sem->_prioMask &= ~((uint32_t)1 << prio);
+	}
+
+	sem->_blocked--;
+
+	return w;
+}
+
+/* withdraw waiter @w from the waiting list of @sem, if still registered there */
+static void removeWaiter(sem_t sem, struct waiter *w, queue_handle_t handle)
+{
+	queue_t queue = sem->_blockingQueues[w->_prio];
+
+	if (queue_delete_handle(queue, handle) == -1)
+	{
+		return;
+	}
+
+	if (queue_length(queue) == 0)
+	{
+		sem->_prioMask &= ~((uint32_t)1 << w->_prio);
+	}
+
+	sem->_blocked--;
+}
+
+/* make blocked waiter @w run again */
+static void unblockWaiter(struct waiter *w, int affine)
+{
+	if (w->_uthread != NULL)
+	{
+		uthreadWake(w->_uthread, affine);
+	}
+	else
+	{
+		thread_unblock(w->_tid);
+	}
+}
+
+/* block the calling waiter @w until it gets unblocked */
+static void blockWaiter(struct waiter *w)
+{
+	w->_cpu = sched_getcpu();
+
+	if (w->_uthread != NULL)
+	{
+		uthreadPark(); /* only blocks the uthread, not its worker */
+	}
+	else
+	{
+		thread_block();
+	}
+}
+
+/*
+ * Wake up waiter @w, just dequeued from @sem. The waiter is withdrawn from all
+ * the other semaphores it was waiting on so that only one of them can pick it.
+ */
+static void wakeWaiter(sem_t sem, struct waiter *w)
+{
+	size_t i;
+
+	for (i = 0; i < w->_count; i++)
+	{
+		removeWaiter(w->_sems[i], w, w->_handles[i]);
+	}
+
+	w->_wokenBy = sem;
+
+	if (w->_callback != NULL)
+	{
+		return; /* the continuation is run by the releaser, see release() */
+	}
+
+#ifdef SEM_STATS
+	if (!topo_share_cache(sched_getcpu(), w->_cpu))
+	{
+		sem->_stats.cross_cache_wakeups++;
+	}
+#endif
+
+	unblockWaiter(w, sem->_wakeAffine);
+}
+
+/*
+ * Take a resource from the first available semaphore of waiter @w, blocking on
+ * all of them at once if none is available.
+ */
+static int waitOn(struct waiter *w, size_t *index)
+{
+	sem_t *sems = w->_sems;
+	size_t i, j;
+
+	w->_blockedAt = 0;
+
+	while (1)
+	{
+		for (i = 0; i < w->_count; i++)
+		{
+			if (sems[i]->_count > 0)
+			{
+				takeResource(sems[i]);
+
+				if (w->_blockedAt != 0)
+				{
+					STAT_WAIT(sems[i], w->_blockedAt);
+				}
+
+				if (w->_since != 0)
+				{
+					recordWait(sems[i], now() - w->_since);
+				}
+
+				*index = i;
+				return 0;
+			}
+		}
+
+		/* no resource is currently avalible, go to sleep */
+		w->_wokenBy = NULL;
+
+		for (i = 0; i < w->_count; i++)
+		{
+			if (enqueueWaiter(sems[i], w, &w->_handles[i]) == -1)
+			{
+				for (j = 0; j < i; j++)
+				{
+					removeWaiter(sems[j], w, w->_handles[j]);
+				}
+
+				return -1;
+			}
+		}
+
+		if (w->_blockedAt == 0)
+		{
+			w->_blockedAt = STAT_NOW();
+		}
+
+		blockWaiter(w);
+
+		if (w->_granted)
+		{
+			/*
+			 * The resource was handed over, and accounted for, by sem_up():
+			 * the semaphore may be destroyed by now, only compare its address
+			 */
+			for (i = 0; sems[i] != w->_wokenBy; i++)
+				;
+
+			*index = i;
+			return 0;
+		}
+
+		/* barging: compete again for the resource released by sem_up() */
+	}
+}
+
+/*
+ * Take a resource from the first available semaphore of @sems, blocking on all
+ * of them at once if none is available. @since is when an adaptive down started
+ * waiting, for the wait to be recorded, 0 otherwise. Must be called within the
+ * critical section.
+ */
+static int waitAny(sem_t *sems, size_t count, unsigned int prio,
+				   uint64_t since, size_t *index)
+{
+	struct waiter w;
+	queue_handle_t handle; /* enough for a single semaphore */
+	int ret;
+
+	w._tid = pthread_self();
+	w._uthread = uthread_self();
+	w._prio = prio;
+	w._sems = sems;
+	w._handles = &handle;
+	w._count = count;
+	w._granted = 0;
+	w._since = since;
+	w._callback = NULL;
+
+	if (count > 1)
+	{
+		w._handles = malloc(count * sizeof(queue_handle_t));
+
+		if (w._handles == NULL)
+		{
+			return -1;
+		}
+	}
+
+	ret = waitOn(&w, index);
+
+	if (count > 1)
+	{
+		free(w._handles);
+	}
+
+	return ret;
+}
+
+/*
+ * Release a resource of @sem, in the critical section. Return the pending
+ * asynchronous take the resource was handed over to, if any, whose
+ * continuation is then up to the caller.
+ */
+static struct waiter *release(sem_t sem)
+{
+	struct waiter *w = dequeueWaiter(sem);
+
+	STAT_ADD(sem, ups, 1);
+
+	if (w == NULL ||
+		(sem->_policy == SEM_POLICY_BARGING && w->_callback == NULL))
+	{
+		/* give the resource back, the next waiter competes for it */
+		giveResource(sem);
+	}
+
+	else
+	{
+		/* pending asynchronous takes cannot compete, always hand over */
+		STAT_ADD(sem, handoffs, 1);
+		STAT_ADD(sem, downs, 1);
+
+		if (w->_blockedAt != 0)
+		{
+			STAT_WAIT(sem, w->_blockedAt);
+		}
+
+		if (w->_since != 0)
+		{
+			recordWait(sem, now() - w->_since);
+		}
+
+		/* the waiter must not access @sem once woken up, see waitOn() */
+		w->_granted = 1;
+	}
+
+	if (w != NULL)
+	{
+		/* unless given back, the resource is handed over directly */
+		wakeWaiter(sem, w);
+	}
+
+	return w != NULL && w->_callback != NULL ? w : NULL;
+}
+
+/* run the continuation of asynchronous take @w and free it */
+static void runCompletion(struct waiter *w)
+{
+	sem_t sem = w->_wokenBy;
+	sem_callback_t callback = w->_callback;
+	void *arg = w->_arg;
+
+	free(w);
+
+	if (sem->_executor != NULL)
+	{
+		sem->_executor(callback, sem, arg, sem->_executorData);
+	}
+	else
+	{
+		callback(sem, arg);
+	}
+}
+
+/*
+ * Run the continuation of asynchronous take @w, just handed a resource by the
+ * calling thread, if not NULL. Must be called out of the critical section.
+ */
+static void runCompletions(struct waiter *w)
+{
+	if (w == NULL)
+	{
+		return;
+	}
+
+	w->_nextCompleted = NULL;
+
+	if (completedTail != NULL)
+	{
+		completedTail->_nextCompleted = w;
+	}
+	else
+	{
+		completedHead = w;
+	}
+
+	completedTail = w;
+
+	/* continuations releasing resources add more, run them in this loop */
+	if (runningCompletions)
+	{
+		return;
+	}
+
+	runningCompletions = 1;
+
+	while (completedHead != NULL)
+	{
+		w = completedHead;
+		completedHead = w->_nextCompleted;
+
+		if (completedHead == NULL)
+		{
+			completedTail = NULL;
+		}
+
+		runCompletion(w);
+	}
+
+	runningCompletions = 0;
+}
+
+/* run the continuations deferred by semCondWait(), forever */
+static void *completerLoop(void *arg)
+{
+	struct waiter *w;
+
+	(void)arg;
+
+	enter_critical_section();
+
+	while (1)
+	{
+		while (deferredHead == NULL)
+		{
+			completerIdle = 1;
+			thread_block();
+		}
+
+		w = deferredHead;
+		deferredHead = w->_nextCompleted;
+
+		if (deferredHead == NULL)
+		{
+			deferredTail = NULL;
+		}
+
+		exit_critical_section();
+		runCompletions(w);
+		enter_critical_section();
+	}
+
+	return NULL;
+}
+
+/*
+ * Start the completer if not already done, in the critical section. It then
+ * waits for the caller to leave the critical section before running anything.
+ */
+static void startCompleter(void)
+{
+	pthread_attr_t attr;
+
+	if (completerStarted)
+	{
+		return;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* in case of failure, deferred continuations wait for the next try */
+	if (pthread_create(&completer, &attr, completerLoop, NULL) == 0)
+	{
+		completerStarted = 1;
+	}
+
+	pthread_attr_destroy(&attr);
+}
+
+/* pass asynchronous take @w to the completer, in the critical section */
+static void deferCompletion(struct waiter *w)
+{
+	w->_nextCompleted = NULL;
+
+	if (deferredTail != NULL)
+	{
+		deferredTail->_nextCompleted = w;
+	}
+	else
+	{
+		deferredHead = w;
+	}
+
+	deferredTail = w;
+
+	if (!completerStarted)
+	{
+		startCompleter();
+	}
+	else if (completerIdle)
+	{
+		completerIdle = 0;
+		thread_unblock(completer);
+	}
+}
+
+int semCondWait(sem_t lock, queue_t waiters)
+{
+	struct waiter w;
+	queue_handle_t handle;
+	size_t index;
+
+	if (lock == NULL || lock->_shared != NULL)
+	{
+		return -1;
+	}
+
+	w._tid = pthread_self();
+	w._uthread = uthread_self();
+	w._prio = SEM_PRIO_DEFAULT;
+	w._sems = &lock;
+	w._handles = &handle;
+	w._count = 1;
+	w._wokenBy = NULL;
+	w._granted = 0;
+	w._since = 0;
+	w._blockedAt = 0;
+	w._callback = NULL;
+
+	if (queue_enqueue(waiters, &w) == -1)
+	{
+		return -1;
+	}
+
+	struct waiter *completed = release(lock);
+
+	/*
+	 * A continuation handed the lock cannot wait for the caller to be woken
+	 * up by someone else, nor be run within the critical section
+	 */
+	if (completed != NULL)
+	{
+		deferCompletion(completed);
+	}
+
+	blockWaiter(&w);
+
+	/* the completer could not be started when the continuation was deferred */
+	if (deferredHead != NULL)
+	{
+		startCompleter();
+	}
+
+	if (w._granted)
+	{
+		/* the lock was free when signaled, or handed over by sem_up() */
+		return 0;
+	}
+
+	/* compete for the lock like any other thread */
+	return waitOn(&w, &index);
+}
+
+void semCondMorph(struct waiter *w)
+{
+	sem_t lock = w->_sems[0];
+
+	if (lock->_count > 0)
+	{
+		takeResource(lock);
+		w->_granted = 1;
+	}
+	else if (enqueueWaiter(lock, w, &w->_handles[0]) == 0)
+	{
+		return; /* woken up by sem_up(), like any thread blocked on it */
+	}
+
+	unblockWaiter(w, lock->_wakeAffine);
+}
+
+sem_t sem_create(size_t count)
+{
+	return sem_create_policy(count, SEM_POLICY_FIFO);
+}
+
+sem_t sem_create_policy(size_t count, sem_policy_t policy)
+{
+	if (policy != SEM_POLICY_FIFO && policy != SEM_POLICY_BARGING)
+	{
+		return NULL;
+	}
+
+	sem_t sem = malloc(sizeof(semaphore));
+
+	if (sem == NULL)
+	{
+		return NULL;
+	}
+
+	sem->_count = count;
+	sem->_policy = policy;
+	sem->_adaptive = 0;
+	sem->_wakeAffine = 0;
+	sem->_executor = NULL;
+	sem->_executorData = NULL;
+	sem->_waitAvg = SEM_SPIN_MIN_NS;
+	sem->_eventFd = -1;
+	sem->_shared = NULL;
+	sem->_name = NULL;
+	sem->_prioMask = 0;
+	sem->_blocked = 0;
+
+	/* queues of other priorities are only created when first needed */
+	for (int i = 0; i < SEM_PRIO_LEVELS; i++)
+	{
+		sem->_blockingQueues[i] = NULL;
+	}
+
+	sem->_blockingQueues[SEM_PRIO_DEFAULT] = queue_create();
+
+	if (sem->_blockingQueues[SEM_PRIO_DEFAULT] == NULL)
+	{
+		return NULL;
+	}
+
+#ifdef SEM_STATS
+	memset(&sem->_stats, 0, sizeof(sem->_stats));
+
+	enter_critical_section();
+
+	if (liveSems == NULL)
+	{
+		liveSems = queue_create();
+	}
+
+	queue_enqueue_handle(liveSems, sem, &sem->_live);
+
+	exit_critical_section();
+#endif
+
+	return sem;
+}
+
+sem_t sem_create_shared(const char *name, size_t count)
 {
-	sem_t sem = malloc(sizeof(semaphore));
+	if (name == NULL || count > INT_MAX)
+	{
+		return NULL;
+	}
+
+	sem_t sem = sem_create(0);
 
 	if (sem == NULL)
 	{
 		return NULL;
 	}
 
-	sem->_count = count;
-	sem->_blockingQueue = queue_create();
+	sem->_shared = sharedSemOpen(name, count);
 
-	if (sem->_blockingQueue == NULL)
+	if (sem->_shared == NULL)
 	{
+		sem_destroy(sem);
 		return NULL;
 	}
 
@@ -35,42 +865,194 @@ sem_t sem_create(size_t count)
 
 int sem_destroy(sem_t sem)
 {
-	if (sem == NULL || queue_length(sem->_blockingQueue) > 0)
+	if (sem == NULL || sem->_blocked > 0)
 	{
 		return -1;
 	}
 
-	queue_destroy(sem->_blockingQueue);
+	for (int i = 0; i < SEM_PRIO_LEVELS; i++)
+	{
+		if (sem->_blockingQueues[i] != NULL)
+		{
+			queue_destroy(sem->_blockingQueues[i]);
+		}
+	}
+
+	if (sem->_eventFd != -1)
+	{
+		close(sem->_eventFd);
+	}
+
+	if (sem->_shared != NULL)
+	{
+		sharedSemClose(sem->_shared);
+	}
+
+#ifdef SEM_STATS
+	enter_critical_section();
+	queue_delete_handle(liveSems, sem->_live);
+	exit_critical_section();
+#endif
+
+	free(sem->_name);
 	free(sem);
 
 	return 0;
 }
 
 int sem_down(sem_t sem)
+{
+	return sem_down_prio(sem, SEM_PRIO_DEFAULT);
+}
+
+int sem_down_prio(sem_t sem, unsigned int prio)
 {
 
-	if (sem == NULL)
+	if (sem == NULL || prio > SEM_PRIO_MAX)
+	{
+		return -1;
+	}
+
+	if (sem->_shared != NULL)
+	{
+		/* priorities only make sense within a process */
+		return prio == SEM_PRIO_DEFAULT ? sharedSemDown(sem->_shared) : -1;
+	}
+
+	uint64_t start = 0;
+
+	if (sem->_adaptive && __atomic_load_n(&sem->_count, __ATOMIC_RELAXED) == 0)
+	{
+		start = now();
+
+		if (spinDown(sem, start))
+		{
+			return 0; /* resource showed up while spinning */
+		}
+	}
+
+	size_t index;
+
+	TRACE(TRACE_SEM_DOWN_BEGIN, sem);
+	enter_critical_section();
+
+	int ret = waitAny(&sem, 1, prio, start, &index);
+
+	exit_critical_section();
+	TRACE(TRACE_SEM_DOWN_END, sem);
+
+	return ret;
+}
+
+int sem_down_any(sem_t *sems, size_t count, size_t *index)
+{
+	size_t i;
+
+	if (sems == NULL || count == 0 || index == NULL)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (sems[i] == NULL || sems[i]->_shared != NULL)
+		{
+			return -1;
+		}
+	}
+
+	TRACE(TRACE_SEM_DOWN_BEGIN, sems[0]);
+	enter_critical_section();
+
+	int ret = waitAny(sems, count, SEM_PRIO_DEFAULT, 0, index);
+
+	exit_critical_section();
+	TRACE(TRACE_SEM_DOWN_END, ret == 0 ? sems[*index] : sems[0]);
+
+	return ret;
+}
+
+int sem_down_async(sem_t sem, sem_callback_t callback, void *arg)
+{
+	struct asyncWaiter *a;
+	struct waiter *w;
+	int ret = 1;
+
+	if (sem == NULL || callback == NULL || sem->_shared != NULL)
 	{
 		return -1;
 	}
 
 	enter_critical_section();
 
-	if (sem->_count == 0)
+	if (sem->_count > 0)
 	{
-		/* no resource is currently avalible, go to sleep */
-		pthread_t tid = pthread_self();
-		queue_enqueue(sem->_blockingQueue, (void *)tid);
-		thread_block();
+		takeResource(sem);
+		exit_critical_section();
+		return 0;
 	}
-	else
+
+	a = malloc(sizeof(struct asyncWaiter));
+
+	if (a == NULL)
+	{
+		exit_critical_section();
+		return -1;
+	}
+
+	a->_sem = sem;
+
+	w = &a->_waiter;
+	w->_tid = pthread_self();
+	w->_uthread = NULL;
+	w->_prio = SEM_PRIO_DEFAULT;
+	w->_sems = &a->_sem;
+	w->_handles = &a->_handle;
+	w->_count = 1;
+	w->_wokenBy = NULL;
+	w->_cpu = sched_getcpu();
+	w->_granted = 0;
+	w->_since = 0;
+	w->_blockedAt = 0;
+	w->_callback = callback;
+	w->_arg = arg;
+
+	if (enqueueWaiter(sem, w, &a->_handle) == -1)
 	{
-		sem->_count--;
+		free(a);
+		ret = -1;
 	}
 
 	exit_critical_section();
 
-	return 0;
+	return ret;
+}
+
+int sem_trydown(sem_t sem)
+{
+	int ret = -1;
+
+	if (sem == NULL)
+	{
+		return -1;
+	}
+
+	if (sem->_shared != NULL)
+	{
+		return sharedSemTryDown(sem->_shared);
+	}
+
+	enter_critical_section();
+
+	if (sem->_count > 0)
+	{
+		takeResource(sem);
+		ret = 0;
+	}
+
+	exit_critical_section();
+
+	return ret;
 }
 
 int sem_up(sem_t sem)
@@ -81,36 +1063,103 @@ int sem_up(sem_t sem)
 		return -1;
 	}
 
+	if (sem->_shared != NULL)
+	{
+		return sharedSemUp(sem->_shared);
+	}
+
+	TRACE(TRACE_SEM_UP, sem);
 	enter_critical_section();
 
-	if (sem->_count == 0)
+	struct waiter *completed = release(sem);
+
+	exit_critical_section();
+
+	runCompletions(completed);
+
+	return 0;
+}
+
+int sem_set_adaptive(sem_t sem, int enable)
+{
+	if (sem == NULL || sem->_shared != NULL)
 	{
-		/* check if any thread is blocked */
-		if (queue_length(sem->_blockingQueue) > 0)
-		{
-			/* release the oldest blocked thread */
+		return -1;
+	}
 
-			pthread_t tid;
-			queue_dequeue(sem->_blockingQueue, (void **)&tid);
+	if (multicore == -1)
+	{
+		multicore = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+	}
 
-			thread_unblock(tid);
-		}
-		else
-		{
-			sem->_count++; /* no other thread is blocked */
-		}
+	sem->_adaptive = enable && multicore;
+
+	return 0;
+}
+
+int sem_set_wake_affine(sem_t sem, int enable)
+{
+	if (sem == NULL || sem->_shared != NULL)
+	{
+		return -1;
 	}
-	else
+
+	sem->_wakeAffine = enable != 0;
+
+	return 0;
+}
+
+int sem_set_executor(sem_t sem, sem_executor_t executor, void *data)
+{
+	if (sem == NULL || sem->_shared != NULL)
 	{
-		/* no other thread is blocked */
-		sem->_count++;
+		return -1;
 	}
 
+	enter_critical_section();
+
+	sem->_executor = executor;
+	sem->_executorData = data;
+
 	exit_critical_section();
 
 	return 0;
 }
 
+int sem_set_robust(sem_t sem, int enable)
+{
+	if (sem == NULL || sem->_shared == NULL)
+	{
+		return -1;
+	}
+
+	sharedSemSetRobust(sem->_shared, enable);
+
+	return 0;
+}
+
+int sem_get_fd(sem_t sem)
+{
+	if (sem == NULL || sem->_shared != NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	if (sem->_eventFd == -1)
+	{
+		sem->_eventFd = eventfd(sem->_count > 0,
+								EFD_SEMAPHORE | EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	int fd = sem->_eventFd;
+
+	exit_critical_section();
+
+	return fd;
+}
+
 int sem_getvalue(sem_t sem, int *sval)
 {
 	if (sem == NULL && sval == NULL)
@@ -118,6 +1167,12 @@ int sem_getvalue(sem_t sem, int *sval)
 		return -1;
 	}
 
+	if (sem->_shared != NULL)
+	{
+		*sval = sharedSemGetValue(sem->_shared);
+		return 0;
+	}
+
 	enter_critical_section();
 
 	if (sem->_count > 0)
@@ -126,10 +1181,131 @@ int sem_getvalue(sem_t sem, int *sval)
 	}
 	else
 	{
-		*sval = -1 * queue_length(sem->_blockingQueue);
+		*sval = -1 * sem->_blocked;
+	}
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int sem_set_name(sem_t sem, const char *name)
+{
+	char *copy = NULL;
+
+	if (sem == NULL)
+	{
+		return -1;
+	}
+
+	if (name != NULL)
+	{
+		copy = strdup(name);
+
+		if (copy == NULL)
+		{
+			return -1;
+		}
+	}
+
+	enter_critical_section();
+
+	free(sem->_name);
+	sem->_name = copy;
+
+	exit_critical_section();
+
+	return 0;
+}
+
+#ifdef SEM_STATS
+/* Callback function that prints the statistics of a semaphore */
+static int dumpStats(void *data, void *arg)
+{
+	sem_t sem = (sem_t)data;
+	FILE *stream = (FILE *)arg;
+	struct sem_stats *st = &sem->_stats;
+	int i;
+
+	if (sem->_name != NULL)
+	{
+		fprintf(stream, "%s:", sem->_name);
+	}
+	else
+	{
+		fprintf(stream, "%p:", (void *)sem);
+	}
+
+	fprintf(stream, " downs %lu blocking %lu ups %lu handoffs %lu"
+					" max_blocked %d cross_cache %lu",
+			(unsigned long)st->downs, (unsigned long)st->blocking_downs,
+			(unsigned long)st->ups, (unsigned long)st->handoffs,
+			st->max_blocked, (unsigned long)st->cross_cache_wakeups);
+
+	if (st->blocking_downs > 0)
+	{
+		fprintf(stream, " wait_avg %luns wait_max %luns\n",
+				(unsigned long)(st->wait_total_ns / st->blocking_downs),
+				(unsigned long)st->wait_max_ns);
+
+		for (i = 0; i < SEM_STATS_BUCKETS; i++)
+		{
+			if (st->wait_hist[i] > 0)
+			{
+				fprintf(stream, "  [%12luns, %12luns) %lu\n", 1UL << i,
+						2UL << i, (unsigned long)st->wait_hist[i]);
+			}
+		}
+	}
+	else
+	{
+		fprintf(stream, "\n");
+	}
+
+	return 0;
+}
+#endif
+
+int sem_get_stats(sem_t sem, struct sem_stats *stats)
+{
+#ifdef SEM_STATS
+	if (sem == NULL || stats == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	*stats = sem->_stats;
+	stats->name = sem->_name;
+
+	exit_critical_section();
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+int sem_dump_stats(FILE *stream)
+{
+#ifdef SEM_STATS
+	if (stream == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	if (liveSems != NULL)
+	{
+		queue_iterate(liveSems, dumpStats, stream, NULL);
 	}
 
 	exit_critical_section();
 
 	return 0;
+#else
+	return -1;
+#endif
 }
@@ -2,6 +2,7 @@
 #define _SEMAPHORE_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/types.h>
 
 /*
@@ -15,6 +16,24 @@
  */
 typedef struct semaphore *sem_t;
 
+/*
+ * sem_policy_t - Semaphore release policy
+ *
+ * SEM_POLICY_FIFO: a released resource is handed directly to the oldest
+ * blocked thread, if any. Threads acquire the semaphore in strict arrival
+ * order.
+ *
+ * SEM_POLICY_BARGING: a released resource goes back into the internal count and
+ * the oldest blocked thread is woken up to compete for it. A running thread may
+ * take the resource before the woken thread gets to run, in which case the
+ * latter blocks again. This trades fairness for throughput by avoiding lock
+ * convoys.
+ */
+typedef enum {
+	SEM_POLICY_FIFO,
+	SEM_POLICY_BARGING,
+} sem_policy_t;
+
 /*
  * sem_create - Create semaphore
  * @count: Semaphore count
@@ -26,6 +45,78 @@ typedef struct semaphore *sem_t;
  */
 sem_t sem_create(size_t count);
 
+/*
+ * sem_create_policy - Create semaphore with a release policy
+ * @count: Semaphore count
+ * @policy: Policy applied when releasing resources to blocked threads
+ *
+ * Allocate and initialize a semaphore of internal count @count following
+ * release policy @policy. sem_create() is equivalent to calling this function
+ * with SEM_POLICY_FIFO.
+ *
+ * Return: Pointer to initialized semaphore. NULL if @policy is invalid, or in
+ * case of failure when allocating the new semaphore.
+ */
+sem_t sem_create_policy(size_t count, sem_policy_t policy);
+
+/*
+ * sem_create_shared - Create or open a process-shared semaphore
+ * @name: Name of the semaphore, of the form "/somename"
+ * @count: Semaphore count, if the semaphore is created
+ *
+ * Open the semaphore called @name, which can be used by threads of different
+ * processes, creating it with internal count @count if it does not exist yet.
+ * The semaphore lives in a POSIX shared memory object and blocked threads sleep
+ * on a futex, so that hand-offs between processes involve at most one system
+ * call on each side.
+ *
+ * Shared semaphores can be taken with sem_down(), sem_trydown() and released
+ * with sem_up(). They cannot be used with waiting priorities, sem_down_any(),
+ * sem_set_adaptive() or sem_get_fd(). sem_destroy() only releases the caller's
+ * handle; the semaphore itself is removed with sem_unlink().
+ *
+ * Return: Pointer to initialized semaphore. NULL if @name is NULL or @count
+ * is greater than INT_MAX, or in case of failure when allocating or opening
+ * the semaphore.
+ */
+sem_t sem_create_shared(const char *name, size_t count);
+
+/*
+ * sem_unlink - Remove a process-shared semaphore
+ * @name: Name of the semaphore
+ *
+ * Remove the name of the process-shared semaphore @name. Processes that have
+ * already opened it can keep using it until they destroy their handle.
+ *
+ * Return: -1 if @name is NULL or does not exist. 0 if @name was successfully
+ * removed.
+ */
+int sem_unlink(const char *name);
+
+/*
+ * sem_set_robust - Recover resources of dead processes
+ * @sem: Process-shared semaphore to configure
+ * @enable: Whether to track resources held by each process
+ *
+ * If @enable is different than 0, the resources each process takes from @sem
+ * and has not released yet are recorded in the semaphore. When a process dies
+ * while holding resources, threads blocked on @sem notice it within a tenth of
+ * a second and give these resources back, even if it died right after taking
+ * one. A process only holds resources until it releases as many as it took, so
+ * that processes merely signalling each other are not affected. Processes are
+ * told apart by their pid and start time, so that a dead process is noticed
+ * even if not reaped yet, or if its pid has been reused.
+ *
+ * The setting is stored in the semaphore and applies to all the processes
+ * using it. Up to 64 processes can take from @sem at once: the slots of dead
+ * processes are reclaimed when none is left, and sem_down() and sem_trydown()
+ * fail if all of them belong to running processes.
+ *
+ * Return: -1 if @sem is NULL or is not process-shared. 0 if @sem was
+ * successfully configured.
+ */
+int sem_set_robust(sem_t sem, int enable);
+
 /*
  * sem_destroy - Deallocate a semaphore
  * @sem: Semaphore to deallocate
@@ -50,6 +141,125 @@ int sem_destroy(sem_t sem);
  */
 int sem_down(sem_t sem);
 
+/*
+ * Range of waiting priorities, higher values being served first
+ */
+#define SEM_PRIO_DEFAULT 0
+#define SEM_PRIO_MAX 31
+
+/*
+ * sem_down_prio - Take a semaphore with a waiting priority
+ * @sem: Semaphore to take
+ * @prio: Priority of the caller, between 0 and SEM_PRIO_MAX
+ *
+ * Take a resource from semaphore @sem, like sem_down().
+ *
+ * If the caller thread has to be blocked, it is queued behind the threads of
+ * same priority @prio but ahead of all the threads of lower priority. Released
+ * resources always go to the oldest blocked thread of highest priority.
+ * sem_down() is equivalent to calling this function with SEM_PRIO_DEFAULT.
+ *
+ * Return: -1 if @sem is NULL, if @prio is out of range, or in case of failure
+ * when queueing the caller thread. 0 if semaphore was successfully taken.
+ */
+int sem_down_prio(sem_t sem, unsigned int prio);
+
+/*
+ * sem_down_any - Take any of several semaphores
+ * @sems: Array of semaphores to take from
+ * @count: Number of semaphores in @sems
+ * @index: Address of data item where the index of the taken semaphore is
+ * received
+ *
+ * Take exactly one resource from the first semaphore of @sems that has one
+ * available, and assign its position in @sems to @index.
+ *
+ * If none of the semaphores is available, the caller thread is blocked on all
+ * of them at once. The first semaphore to release a resource to the caller
+ * wakes it up and withdraws it from the waiting lists of the other ones.
+ *
+ * Return: -1 if @sems or @index are NULL, if @count is 0, if any semaphore of
+ * @sems is NULL, or in case of failure when queueing the caller thread. 0 if a
+ * semaphore was successfully taken.
+ */
+int sem_down_any(sem_t *sems, size_t count, size_t *index);
+
+/*
+ * sem_callback_t - Continuation of an asynchronous take
+ * @sem: Semaphore a resource was taken from
+ * @arg: Argument given to sem_down_async()
+ *
+ * Called once a resource of @sem was handed over to a pending asynchronous
+ * take. The resource belongs to the callback, which releases it with sem_up()
+ * when done. Callbacks should not block.
+ */
+typedef void (*sem_callback_t)(sem_t sem, void *arg);
+
+/*
+ * sem_executor_t - Executor of asynchronous take continuations
+ * @callback: Continuation to run
+ * @sem: Semaphore a resource was taken from
+ * @arg: Argument of @callback
+ * @data: Data given to sem_set_executor()
+ *
+ * Called instead of @callback by the thread releasing the resource, for
+ * @callback(@sem, @arg) to be run wherever the executor sees fit (e.g. queued
+ * to an event loop).
+ */
+typedef void (*sem_executor_t)(sem_callback_t callback, sem_t sem, void *arg,
+			       void *data);
+
+/*
+ * sem_down_async - Take a semaphore without waiting for it
+ * @sem: Semaphore to take
+ * @callback: Function to call once a resource is taken
+ * @arg: Argument of @callback
+ *
+ * Take a resource from semaphore @sem if one is available. Otherwise, register
+ * a pending take in the waiting list of @sem, served in turn like the blocked
+ * threads: when sem_up() hands a resource over to it, @callback(@sem, @arg) is
+ * called by the releasing thread, once out of sem_up() internals, or passed to
+ * the executor of @sem if any. When cond_wait() hands its lock over, the
+ * continuation is run by an internal thread of the library instead, started
+ * the first time this happens, since the caller of cond_wait() blocks. The
+ * resource is always handed over to pending takes, whatever the policy of
+ * @sem.
+ *
+ * The caller thread never blocks, so that a few threads can have any number of
+ * takes pending.
+ *
+ * Return: -1 if @sem or @callback are NULL, if @sem is process-shared, or in
+ * case of failure when registering the take. 0 if a resource was taken right
+ * away, in which case @callback is not called. 1 if the take is pending.
+ */
+int sem_down_async(sem_t sem, sem_callback_t callback, void *arg);
+
+/*
+ * sem_set_executor - Select where continuations run
+ * @sem: Semaphore to configure
+ * @executor: Executor of the continuations of @sem, NULL for none
+ * @data: Argument of @executor
+ *
+ * Pass the continuations of the pending asynchronous takes of @sem to
+ * @executor, instead of having the releasing thread call them.
+ *
+ * Return: -1 if @sem is NULL or is process-shared. 0 if @sem was successfully
+ * configured.
+ */
+int sem_set_executor(sem_t sem, sem_executor_t executor, void *data);
+
+/*
+ * sem_trydown - Take a semaphore without blocking
+ * @sem: Semaphore to take
+ *
+ * Take a resource from semaphore @sem if one is available, without ever
+ * blocking the caller thread.
+ *
+ * Return: -1 if @sem is NULL or if no resource is currently available. 0 if
+ * semaphore was successfully taken.
+ */
+int sem_trydown(sem_t sem);
+
 /*
  * sem_up - Release a semaphore
  * @sem: Semaphore to release
@@ -57,13 +267,67 @@ int sem_down(sem_t sem);
  * Release a resource to semaphore @sem.
  *
  * If the waiting list associated to @sem is not empty, releasing a resource
- * also causes the first thread (i.e. the oldest) in the waiting list to be
- * unblocked.
+ * also causes the first thread (i.e. the oldest of highest priority) in the
+ * waiting list to be unblocked. Depending on the policy of @sem, the resource
+ * is either handed over to that thread or put back in the internal count.
  *
  * Return: -1 if @sem is NULL. 0 if semaphore was successfully released.
  */
 int sem_up(sem_t sem);
 
+/*
+ * sem_set_adaptive - Select adaptive waiting
+ * @sem: Semaphore to configure
+ * @enable: Whether to spin before going to sleep
+ *
+ * If @enable is different than 0, a thread taking an unavailable semaphore
+ * @sem first polls it for a short while before being blocked. The polling
+ * budget adapts to the wait times recently observed on @sem, so that short
+ * hand-offs between threads avoid a full sleep/wake-up cycle while long waits
+ * quickly stop burning cpu. Adaptive waiting is disabled on single-cpu
+ * machines.
+ *
+ * Return: -1 if @sem is NULL or is process-shared. 0 if @sem was successfully
+ * configured.
+ */
+int sem_set_adaptive(sem_t sem, int enable);
+
+/*
+ * sem_set_wake_affine - Wake up blocked uthreads next to their waker
+ * @sem: Semaphore to configure
+ * @enable: Whether to favor the worker of the waker
+ *
+ * If @enable is different than 0, a uthread woken up by sem_up() on @sem from
+ * another uthread (or from a worker) is run next by the same worker, instead
+ * of being queued behind all the runnable uthreads for any worker to pick.
+ * The data the waker just produced is then still in the cache when the woken
+ * uthread consumes it, which suits pipelines of uthreads handing data to each
+ * other. Kernel threads are not affected, the kernel scheduler already favors
+ * waking them up close to their waker.
+ *
+ * Return: -1 if @sem is NULL or is process-shared. 0 if @sem was successfully
+ * configured.
+ */
+int sem_set_wake_affine(sem_t sem, int enable);
+
+/*
+ * sem_get_fd - Get a pollable file descriptor for a semaphore
+ * @sem: Semaphore to poll
+ *
+ * Return a file descriptor that can be watched with poll(), select() or epoll
+ * and that is readable whenever semaphore @sem has resources available. The
+ * descriptor is an eventfd in semaphore mode, created on the first call and
+ * closed by sem_destroy(); it must not be read from or written to directly.
+ *
+ * The descriptor is only signalled when the count of @sem goes from zero to
+ * non-zero. Once it is reported readable, resources should be taken with
+ * sem_trydown() until it fails: another thread may have taken them first.
+ *
+ * Return: -1 if @sem is NULL or in case of failure when creating the
+ * descriptor. The file descriptor otherwise.
+ */
+int sem_get_fd(sem_t sem);
+
 /*
  * sem_getvalue - Inspect semaphore's internal state
  * @sem: Semaphore to inspect
@@ -81,4 +345,76 @@ int sem_up(sem_t sem);
  */
 int sem_getvalue(sem_t sem, int *sval);
 
+/*
+ * sem_set_name - Name a semaphore
+ * @sem: Semaphore to name
+ * @name: Name of the semaphore, or NULL to remove the current name
+ *
+ * Attach a copy of @name to semaphore @sem, to identify it in statistics.
+ *
+ * Return: -1 if @sem is NULL or in case of failure when copying @name. 0 if
+ * @sem was successfully named.
+ */
+int sem_set_name(sem_t sem, const char *name);
+
+/*
+ * Number of buckets of the wait time histogram
+ */
+#define SEM_STATS_BUCKETS 32
+
+/*
+ * struct sem_stats - Semaphore contention statistics
+ *
+ * @name: Name of the semaphore, NULL if unnamed
+ * @downs: Resources taken from the semaphore
+ * @blocking_downs: Resources taken after the taker had been blocked
+ * @ups: Resources released to the semaphore
+ * @handoffs: Resources handed over directly to a blocked thread
+ * @wait_total_ns: Total time spent blocked by takers
+ * @wait_max_ns: Longest time spent blocked by a taker
+ * @wait_hist: Histogram of blocked times, bucket i counting waits from 2^i
+ * included to 2^(i+1) excluded nanoseconds (the last one counting all the
+ * longer waits)
+ * @max_blocked: Largest number of threads blocked at once
+ * @cross_cache_wakeups: Blocked threads woken up from a cpu that does not
+ * share its last-level cache with the cpu they last ran on
+ */
+struct sem_stats {
+	const char *name;
+	uint64_t downs;
+	uint64_t blocking_downs;
+	uint64_t ups;
+	uint64_t handoffs;
+	uint64_t wait_total_ns;
+	uint64_t wait_max_ns;
+	uint64_t wait_hist[SEM_STATS_BUCKETS];
+	int max_blocked;
+	uint64_t cross_cache_wakeups;
+};
+
+/*
+ * sem_get_stats - Get semaphore statistics
+ * @sem: Semaphore to inspect
+ * @stats: Address of structure receiving the statistics
+ *
+ * Statistics are only collected when the library is built with `make STATS=1`;
+ * otherwise they cost nothing and this function always fails. They are not
+ * collected for process-shared semaphores.
+ *
+ * Return: -1 if @sem or @stats are NULL, or if statistics are disabled. 0 if
+ * @stats was successfully filled.
+ */
+int sem_get_stats(sem_t sem, struct sem_stats *stats);
+
+/*
+ * sem_dump_stats - Print statistics of all semaphores
+ * @stream: Stream to print to
+ *
+ * Print the statistics of every existing semaphore to @stream, one line per
+ * semaphore followed by the non-empty buckets of its wait time histogram.
+ *
+ * Return: -1 if @stream is NULL or if statistics are disabled. 0 otherwise.
+ */
+int sem_dump_stats(FILE *stream);
+
 #endif /* _SEMAPHORE_H */
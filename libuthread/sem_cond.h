@@ -0,0 +1,33 @@
+#ifndef _SEM_COND_H
+#define _SEM_COND_H
+
+#include "queue.h"
+#include "sem.h"
+
+/*
+ * Condition variable support, for internal use by cond.c
+ *
+ * Threads waiting on a condition variable are queued as waiters of the
+ * semaphore they use as a lock, which is not released to them when signaled:
+ * they are moved to the waiting list of the lock instead, so that they only
+ * run once they own the lock.
+ */
+struct waiter;
+
+/*
+ * Register the caller in @waiters, release @lock (held by the caller) and
+ * block until the caller is signaled and owns @lock again. Must be called
+ * within the critical section. Return -1 if @lock is NULL or process-shared,
+ * or in case of failure when queueing the caller.
+ */
+int semCondWait(sem_t lock, queue_t waiters);
+
+/*
+ * Hand waiter @w, just dequeued from the waiters of a condition variable, over
+ * to its lock: it is woken up owning the lock if the lock is free, or moved
+ * to the waiting list of the lock otherwise. Must be called within the
+ * critical section.
+ */
+void semCondMorph(struct waiter *w);
+
+#endif /* _SEM_COND_H */
@@ -0,0 +1,538 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "futex.h"
+#include "sem.h"
+#include "sem_shared.h"
+#include "thread.h"
+
+#define SHARED_MAGIC 0x53454d32 /* "SEM2" */
+#define SHARED_CHECK_MS 100		/* how often sleepers look for dead holders */
+#define SHARED_OPEN_TRIES 1000	/* how long to wait for the creator (ms) */
+#define SHARED_TAKER_SPINS 100	/* yields before suspecting a dead taker */
+
+/*
+ * In robust mode, a take is recorded in the holder slot of the taking process
+ * atomically with the decrement of the count: the count shares a word with
+ * the mark of the process being the last to take, until it has recorded the
+ * take in its slot. The mark identifies the slot, and the number of takes
+ * recorded in it before that one, so that if the process dies in between,
+ * whoever reclaims its slot can tell whether the take was recorded.
+ */
+#define COUNT(state) ((uint32_t)(state))
+#define TAKER(state) ((uint32_t)((state) >> 32))
+#define MARK(slot, takes) ((uint32_t)((slot) + 1) | ((takes) & 0xffffff) << 8)
+#define MARK_SLOT(mark) ((int)((mark) & 0xff) - 1)
+
+/* a holder slot's word: resources held, takes recorded */
+#define HELD(word) ((uint32_t)(word))
+#define TAKES(word) ((uint32_t)((word) >> 32))
+#define ONE_TAKE ((uint64_t)1 << 32 | 1)
+
+struct sharedSem
+{
+	struct sharedArea *_area;
+	pid_t _slotPid; /* process owning the cached holder slot */
+	int _slot;		/* holder slot of the current process, -1 if none */
+};
+
+/* futex word: the count half of the state */
+static uint32_t *countWord(struct sharedArea *a)
+{
+	return (uint32_t *)&a->_state +
+		   (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+}
+
+/*
+ * Start time of process @pid, in clock ticks since boot, which tells it apart
+ * from later processes reusing its pid. Return 0 if it cannot be read, and set
+ * @dead if the process is not running anymore (including zombies).
+ */
+static uint64_t processStart(pid_t pid, int *dead)
+{
+	char path[32], buf[512], *p;
+	unsigned long long start;
+	ssize_t n;
+	int fd, i;
+
+	*dead = 0;
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+	fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+	{
+		/* /proc may not be mounted, fall back to the pid alone */
+		*dead = kill(pid, 0) == -1 && errno == ESRCH;
+		return 0;
+	}
+
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+
+	/* the command name may contain anything, skip to its closing paren */
+	buf[n > 0 ? n : 0] = '\0';
+	p = strrchr(buf, ')');
+
+	if (p == NULL || p[1] == '\0')
+	{
+		return 0;
+	}
+
+	*dead = p[2] == 'Z' || p[2] == 'X';
+
+	/* start time is the 22nd field: skip to the space before it, the one
+	 * following the paren being before the 3rd */
+	for (i = 3; i <= 22 && p != NULL; i++)
+	{
+		p = strchr(p + 1, ' ');
+	}
+
+	if (p == NULL || sscanf(p, "%llu", &start) != 1)
+	{
+		return 0;
+	}
+
+	return start;
+}
+
+/* whether the process holding slot @h is not running anymore */
+static int holderDead(struct holder *h, int32_t pid)
+{
+	int dead;
+	uint64_t start = processStart(pid, &dead);
+
+	return dead || (start != 0 && __atomic_load_n(&h->_start,
+												  __ATOMIC_ACQUIRE) != start);
+}
+
+/*
+ * Give back the resources held by process @pid in slot @i, including a take it
+ * had not recorded yet, unless another process is already reclaiming the slot
+ */
+static void reclaimSlot(struct sharedArea *a, int i, int32_t pid)
+{
+	struct holder *h = &a->_holders[i];
+
+	/* make sure only one process reclaims the slot */
+	if (!__atomic_compare_exchange_n(&h->_pid, &pid, -1, 0, __ATOMIC_ACQ_REL,
+									 __ATOMIC_RELAXED))
+	{
+		return;
+	}
+
+	uint64_t word = __atomic_load_n(&h->_word, __ATOMIC_ACQUIRE);
+	uint64_t state = __atomic_load_n(&a->_state, __ATOMIC_ACQUIRE);
+	uint32_t held = HELD(word);
+
+	while (MARK_SLOT(TAKER(state)) == i)
+	{
+		/* died right after taking: count the take if it is not yet */
+		if (TAKER(state) == MARK(i, TAKES(word)))
+		{
+			held++;
+		}
+
+		if (__atomic_compare_exchange_n(&a->_state, &state, COUNT(state), 0,
+										__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+
+		held = HELD(word);
+	}
+
+	__atomic_store_n(&h->_word, 0, __ATOMIC_RELAXED);
+
+	if (held > 0)
+	{
+		__atomic_add_fetch(&a->_state, held, __ATOMIC_SEQ_CST);
+		futex_wake(countWord(a), held, 1);
+	}
+
+	__atomic_store_n(&h->_pid, 0, __ATOMIC_RELEASE);
+}
+
+/* Give back the resources held by processes that died without releasing them */
+static void reclaimDead(struct sharedArea *a)
+{
+	int i;
+
+	for (i = 0; i < SHARED_HOLDERS; i++)
+	{
+		struct holder *h = &a->_holders[i];
+		int32_t pid = __atomic_load_n(&h->_pid, __ATOMIC_ACQUIRE);
+
+		if (pid > 0 && holderDead(h, pid))
+		{
+			reclaimSlot(a, i, pid);
+		}
+	}
+}
+
+/*
+ * Find the holder slot of the current process, claiming a free one if @claim
+ * is set, after reclaiming the slots of dead processes if none is free. The
+ * cached slot is checked against the pid, as handles are inherited by forked
+ * children, and a slot with the pid of the current process but another start
+ * time, left by a dead process whose pid got reused, is reclaimed.
+ */
+static struct holder *ownSlot(struct sharedSem *s, int claim)
+{
+	struct holder *holders = s->_area->_holders;
+	pid_t pid = getpid();
+	uint64_t start;
+	int i, dead, tries;
+
+	enter_critical_section();
+
+	if (s->_slotPid != pid || s->_slot == -1)
+	{
+		s->_slotPid = pid;
+		s->_slot = -1;
+		start = processStart(pid, &dead);
+
+		for (i = 0; i < SHARED_HOLDERS && s->_slot == -1; i++)
+		{
+			if (__atomic_load_n(&holders[i]._pid, __ATOMIC_ACQUIRE) != pid)
+			{
+				continue;
+			}
+
+			if (__atomic_load_n(&holders[i]._start, __ATOMIC_ACQUIRE) == start)
+			{
+				s->_slot = i;
+			}
+			else
+			{
+				reclaimSlot(s->_area, i, pid);
+			}
+		}
+
+		for (tries = 0; tries < 2 && s->_slot == -1 && claim; tries++)
+		{
+			if (tries == 1)
+			{
+				reclaimDead(s->_area);
+			}
+
+			for (i = 0; i < SHARED_HOLDERS && s->_slot == -1; i++)
+			{
+				int32_t expected = 0;
+
+				if (!__atomic_compare_exchange_n(&holders[i]._pid, &expected,
+												 -1, 0, __ATOMIC_ACQ_REL,
+												 __ATOMIC_RELAXED))
+				{
+					continue;
+				}
+
+				/* not reclaimable until both are set */
+				__atomic_store_n(&holders[i]._start, start, __ATOMIC_RELAXED);
+				__atomic_store_n(&holders[i]._pid, pid, __ATOMIC_RELEASE);
+				s->_slot = i;
+			}
+		}
+	}
+
+	int slot = s->_slot;
+
+	exit_critical_section();
+
+	return slot == -1 ? NULL : &holders[slot];
+}
+
+/* account for a resource given back by the current process in robust mode */
+static void unholdResource(struct sharedSem *s)
+{
+	if (!__atomic_load_n(&s->_area->_robust, __ATOMIC_RELAXED))
+	{
+		return;
+	}
+
+	struct holder *h = ownSlot(s, 0);
+
+	if (h == NULL)
+	{
+		return;
+	}
+
+	uint64_t word = __atomic_load_n(&h->_word, __ATOMIC_RELAXED);
+
+	/* processes only signalling others do not hold anything */
+	while (HELD(word) > 0 &&
+		   !__atomic_compare_exchange_n(&h->_word, &word, word - 1, 0,
+										__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/*
+ * Take a resource if one is available, recording it in holder slot @h of the
+ * current process if not NULL
+ */
+static int tryTake(struct sharedArea *a, struct holder *h)
+{
+	uint64_t state = __atomic_load_n(&a->_state, __ATOMIC_RELAXED);
+	int spins = 0;
+
+	while (h == NULL)
+	{
+		if (COUNT(state) == 0)
+		{
+			return 0;
+		}
+
+		if (__atomic_compare_exchange_n(&a->_state, &state, state - 1, 0,
+										__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		{
+			return 1;
+		}
+	}
+
+	for (;;)
+	{
+		/*
+		 * The threads of a process take one at a time, so that the takes
+		 * recorded in its slot do not change until its mark is cleared
+		 */
+		enter_critical_section();
+
+		state = __atomic_load_n(&a->_state, __ATOMIC_ACQUIRE);
+
+		if (COUNT(state) > 0 && TAKER(state) == 0)
+		{
+			uint64_t word = __atomic_load_n(&h->_word, __ATOMIC_RELAXED);
+			uint64_t mark = MARK(h - a->_holders, TAKES(word));
+
+			if (__atomic_compare_exchange_n(&a->_state, &state,
+											(state - 1) | mark << 32, 0,
+											__ATOMIC_ACQ_REL,
+											__ATOMIC_ACQUIRE))
+			{
+				__atomic_add_fetch(&h->_word, ONE_TAKE, __ATOMIC_ACQ_REL);
+				__atomic_and_fetch(&a->_state, UINT32_MAX, __ATOMIC_RELEASE);
+				exit_critical_section();
+				return 1;
+			}
+		}
+
+		exit_critical_section();
+
+		if (COUNT(state) == 0)
+		{
+			return 0;
+		}
+
+		/* another process is recording its take, unless it died doing so */
+		if (TAKER(state) != 0)
+		{
+			if (++spins % SHARED_TAKER_SPINS == 0)
+			{
+				reclaimDead(a);
+			}
+
+			sched_yield();
+		}
+	}
+}
+
+/* holder slot to record takes in, NULL if not robust, or -1 if none is left */
+static struct holder *takerSlot(struct sharedSem *s)
+{
+	if (!__atomic_load_n(&s->_area->_robust, __ATOMIC_RELAXED))
+	{
+		return NULL;
+	}
+
+	struct holder *h = ownSlot(s, 1);
+
+	return h != NULL ? h : (struct holder *)-1;
+}
+
+struct sharedSem *sharedSemOpen(const char *name, unsigned int count)
+{
+	struct sharedArea *area;
+	struct stat st;
+	int created = 1;
+	int tries;
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+	if (fd == -1 && errno == EEXIST)
+	{
+		created = 0;
+		fd = shm_open(name, O_RDWR, 0);
+	}
+
+	if (fd == -1)
+	{
+		return NULL;
+	}
+
+	if (created && ftruncate(fd, sizeof(*area)) == -1)
+	{
+		close(fd);
+		shm_unlink(name);
+		return NULL;
+	}
+
+	/* the creator may not have sized the object yet */
+	for (tries = 0; !created; tries++)
+	{
+		if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(*area))
+		{
+			break;
+		}
+
+		if (tries == SHARED_OPEN_TRIES)
+		{
+			close(fd);
+			return NULL;
+		}
+
+		usleep(1000);
+	}
+
+	area = mmap(NULL, sizeof(*area), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (area == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	if (created)
+	{
+		area->_state = count;
+		__atomic_store_n(&area->_magic, SHARED_MAGIC, __ATOMIC_RELEASE);
+	}
+
+	for (tries = 0; __atomic_load_n(&area->_magic, __ATOMIC_ACQUIRE) !=
+					SHARED_MAGIC;
+		 tries++)
+	{
+		if (tries == SHARED_OPEN_TRIES)
+		{
+			munmap(area, sizeof(*area));
+			return NULL;
+		}
+
+		usleep(1000);
+	}
+
+	struct sharedSem *s = malloc(sizeof(struct sharedSem));
+
+	if (s == NULL)
+	{
+		munmap(area, sizeof(*area));
+		return NULL;
+	}
+
+	s->_area = area;
+	s->_slotPid = 0;
+	s->_slot = -1;
+
+	return s;
+}
+
+void sharedSemClose(struct sharedSem *s)
+{
+	munmap(s->_area, sizeof(struct sharedArea));
+	free(s);
+}
+
+int sharedSemDown(struct sharedSem *s)
+{
+	struct sharedArea *a = s->_area;
+	struct timespec check = {0, SHARED_CHECK_MS * 1000000};
+	struct holder *h = takerSlot(s);
+
+	if (h == (struct holder *)-1)
+	{
+		return -1;
+	}
+
+	while (!tryTake(a, h))
+	{
+		/* sem_up() checks for sleepers after incrementing the count */
+		__atomic_add_fetch(&a->_waiters, 1, __ATOMIC_SEQ_CST);
+
+		int robust = __atomic_load_n(&a->_robust, __ATOMIC_RELAXED);
+		int ret = futex_wait(countWord(a), 0, robust ? &check : NULL, 1);
+
+		__atomic_sub_fetch(&a->_waiters, 1, __ATOMIC_SEQ_CST);
+
+		if (ret == -1 && errno == ETIMEDOUT)
+		{
+			reclaimDead(a);
+		}
+	}
+
+	return 0;
+}
+
+int sharedSemTryDown(struct sharedSem *s)
+{
+	struct holder *h = takerSlot(s);
+
+	if (h == (struct holder *)-1 || !tryTake(s->_area, h))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+int sharedSemUp(struct sharedSem *s)
+{
+	struct sharedArea *a = s->_area;
+
+	unholdResource(s);
+
+	__atomic_add_fetch(&a->_state, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&a->_waiters, __ATOMIC_SEQ_CST) > 0)
+	{
+		futex_wake(countWord(a), 1, 1);
+	}
+
+	return 0;
+}
+
+int sharedSemGetValue(struct sharedSem *s)
+{
+	uint64_t state = __atomic_load_n(&s->_area->_state, __ATOMIC_RELAXED);
+	uint32_t count = COUNT(state);
+
+	if (count > 0)
+	{
+		return count > INT_MAX ? INT_MAX : (int)count;
+	}
+
+	return -1 * (int)__atomic_load_n(&s->_area->_waiters, __ATOMIC_RELAXED);
+}
+
+void sharedSemSetRobust(struct sharedSem *s, int enable)
+{
+	__atomic_store_n(&s->_area->_robust, enable != 0, __ATOMIC_RELAXED);
+}
+
+int sem_unlink(const char *name)
+{
+	if (name == NULL)
+	{
+		return -1;
+	}
+
+	return shm_unlink(name);
+}
@@ -0,0 +1,63 @@
+#ifndef _SEM_SHARED_H
+#define _SEM_SHARED_H
+
+/*
+ * Process-shared semaphore state, for internal use by sem.c
+ *
+ * The state lives in a named POSIX shared memory object and is operated on
+ * with atomic instructions, sleeping on futexes when no resource is available.
+ * Each process opening the object gets its own handle.
+ */
+struct sharedSem;
+
+#include <stdint.h>
+
+#define SHARED_HOLDERS 64 /* processes tracked in robust mode */
+
+/*
+ * Layout of the shared memory object, known to the tests so that they can
+ * plant the holder slots of processes that died or whose pid got reused
+ */
+
+/* resources taken, and not given back yet, by a process */
+struct holder
+{
+	int32_t _pid;	 /* 0 if free, -1 while being claimed or reclaimed */
+	uint64_t _start; /* start time of the process, from /proc/<pid>/stat */
+	uint64_t _word;	 /* resources held (low half), takes recorded (high) */
+};
+
+struct sharedArea
+{
+	uint64_t _state;   /* internal count (low half), mark of the taker */
+	uint32_t _waiters; /* threads sleeping on the count, in all processes */
+	uint32_t _robust;  /* track resources held by each process */
+	uint32_t _magic;   /* set once the area is initialized */
+	struct holder _holders[SHARED_HOLDERS];
+};
+
+/*
+ * Open the shared semaphore called @name, creating it with internal count
+ * @count if it does not exist yet. Return NULL in case of failure.
+ */
+struct sharedSem *sharedSemOpen(const char *name, unsigned int count);
+
+/* Release handle @s, leaving the shared object untouched */
+void sharedSemClose(struct sharedSem *s);
+
+/* Take a resource, blocking until one is available */
+int sharedSemDown(struct sharedSem *s);
+
+/* Take a resource if one is available, return -1 otherwise */
+int sharedSemTryDown(struct sharedSem *s);
+
+/* Release a resource, waking up a sleeping thread if any */
+int sharedSemUp(struct sharedSem *s);
+
+/* Same semantics as sem_getvalue() */
+int sharedSemGetValue(struct sharedSem *s);
+
+/* Enable or disable tracking of resources held by each process */
+void sharedSemSetRobust(struct sharedSem *s, int enable);
+
+#endif /* _SEM_SHARED_H */
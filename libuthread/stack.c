@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stack.h"
+
+#define STACK_CLASSES 10   /* STACK_MIN_SIZE << 9 == STACK_MAX_POOLED */
+#define STACK_POOL_DEPTH 64 /* free stacks kept per class */
+
+/*
+ * A pooled stack is linked to the next one of its class through its very last
+ * word, in the top page that is kept committed.
+ */
+static struct
+{
+	void *_free[STACK_CLASSES];
+	size_t _count[STACK_CLASSES]; /* stacks in the pool or being put in it */
+} pool;
+
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+static int lazyFree = 1; /* MADV_FREE is supported */
+
+/* Size class of a stack of @size bytes, STACK_CLASSES if not pooled */
+static unsigned int classOf(size_t size)
+{
+	unsigned int class = 0;
+
+	while (class < STACK_CLASSES && ((size_t)STACK_MIN_SIZE << class) < size)
+	{
+		class++;
+	}
+
+	return class;
+}
+
+/* Actual size of a stack of at least @size bytes */
+static size_t stackSize(size_t size)
+{
+	unsigned int class = classOf(size);
+	size_t page = getpagesize();
+
+	if (class < STACK_CLASSES)
+	{
+		return (size_t)STACK_MIN_SIZE << class;
+	}
+
+	return (size + page - 1) & ~(page - 1);
+}
+
+static void **nextOf(void *stack, size_t size)
+{
+	return (void **)((char *)stack + size) - 1;
+}
+
+/* Give the memory of @stack back to the system, but its top page */
+static void release(void *stack, size_t size)
+{
+	size_t length = size - getpagesize();
+
+#ifdef MADV_FREE
+	if (__atomic_load_n(&lazyFree, __ATOMIC_RELAXED) &&
+		madvise(stack, length, MADV_FREE) == 0)
+	{
+		return;
+	}
+
+	if (errno == EINVAL)
+	{
+		/* kernel older than 4.5 */
+		__atomic_store_n(&lazyFree, 0, __ATOMIC_RELAXED);
+	}
+#endif
+
+	madvise(stack, length, MADV_DONTNEED);
+}
+
+void *stack_alloc(size_t size)
+{
+	unsigned int class = classOf(size);
+	size_t page = getpagesize();
+	char *map;
+	void *stack = NULL;
+
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	size = stackSize(size);
+
+	if (class < STACK_CLASSES)
+	{
+		pthread_mutex_lock(&poolLock);
+
+		stack = pool._free[class];
+
+		if (stack != NULL)
+		{
+			pool._free[class] = *nextOf(stack, size);
+			pool._count[class]--;
+		}
+
+		pthread_mutex_unlock(&poolLock);
+
+		if (stack != NULL)
+		{
+			return stack;
+		}
+	}
+
+	map = mmap(NULL, size + page, PROT_READ | PROT_WRITE,
+			   MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+
+	if (map == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	/* guard page, so that a stack overflow faults instead of going unnoticed */
+	mprotect(map, page, PROT_NONE);
+
+	return map + page;
+}
+
+int stack_free(void *stack, size_t size)
+{
+	unsigned int class = classOf(size);
+	size_t page = getpagesize();
+
+	if (stack == NULL || size == 0)
+	{
+		return -1;
+	}
+
+	size = stackSize(size);
+
+	if (class < STACK_CLASSES)
+	{
+		int pooled = 0;
+
+		/* book a place in the pool, so that its memory is released unlocked,
+		 * and only if it is not unmapped anyway */
+		pthread_mutex_lock(&poolLock);
+
+		if (pool._count[class] < STACK_POOL_DEPTH)
+		{
+			pool._count[class]++;
+			pooled = 1;
+		}
+
+		pthread_mutex_unlock(&poolLock);
+
+		if (pooled)
+		{
+			release(stack, size);
+
+			pthread_mutex_lock(&poolLock);
+			*nextOf(stack, size) = pool._free[class];
+			pool._free[class] = stack;
+			pthread_mutex_unlock(&poolLock);
+
+			return 0;
+		}
+	}
+
+	munmap((char *)stack - page, size + page);
+
+	return 0;
+}
+
+int stack_pool_trim(void)
+{
+	size_t page = getpagesize();
+	size_t size;
+	void *stack;
+	unsigned int class;
+	int n = 0;
+
+	pthread_mutex_lock(&poolLock);
+
+	for (class = 0; class < STACK_CLASSES; class++)
+	{
+		size = (size_t)STACK_MIN_SIZE << class;
+
+		while ((stack = pool._free[class]) != NULL)
+		{
+			pool._free[class] = *nextOf(stack, size);
+			pool._count[class]--;
+			munmap((char *)stack - page, size + page);
+			n++;
+		}
+	}
+
+	pthread_mutex_unlock(&poolLock);
+
+	return n;
+}
+
+int stack_attr_init(pthread_attr_t *attr, size_t size)
+{
+	void *stack;
+
+	if (attr == NULL || size < PTHREAD_STACK_MIN)
+	{
+		return -1;
+	}
+
+	size = stackSize(size);
+	stack = stack_alloc(size);
+
+	if (stack == NULL)
+	{
+		return -1;
+	}
+
+	if (pthread_attr_init(attr) != 0)
+	{
+		stack_free(stack, size);
+		return -1;
+	}
+
+	if (pthread_attr_setstack(attr, stack, size) != 0)
+	{
+		pthread_attr_destroy(attr);
+		stack_free(stack, size);
+		return -1;
+	}
+
+	return 0;
+}
+
+int stack_attr_destroy(pthread_attr_t *attr)
+{
+	void *stack;
+	size_t size;
+
+	if (attr == NULL || pthread_attr_getstack(attr, &stack, &size) != 0 ||
+		stack == NULL)
+	{
+		return -1;
+	}
+
+	stack_free(stack, size);
+	pthread_attr_destroy(attr);
+
+	return 0;
+}
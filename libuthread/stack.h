@@ -0,0 +1,90 @@
+#ifndef _STACK_H
+#define _STACK_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * Pool of thread stacks
+ *
+ * Stacks are sorted into size classes, powers of two from STACK_MIN_SIZE to
+ * STACK_MAX_POOLED. Released stacks of these sizes are kept in the pool of
+ * their class and handed out again by later allocations, saving the mapping
+ * of a fresh stack and of its guard page, and the page faults of its first
+ * use. The memory of a pooled stack is returned to the system lazily (with
+ * MADV_FREE where available), except for its top page which stays warm for
+ * the next thread. Larger stacks are mapped and unmapped directly.
+ *
+ * Every stack lies right above a guard page, so that a stack overflow faults
+ * instead of going unnoticed. Stacks are never committed upfront: pages only
+ * get backed by memory once touched.
+ */
+#define STACK_MIN_SIZE (16 * 1024)
+#define STACK_MAX_POOLED (8 * 1024 * 1024)
+
+/*
+ * stack_alloc - Allocate a thread stack
+ * @size: Minimum size of the stack in bytes
+ *
+ * Allocate a stack of at least @size bytes, reusing a pooled one if possible.
+ * The stack grows down from the address returned plus @size.
+ *
+ * Return: Lowest address of the stack. NULL if @size is 0, or in case of
+ * failure when mapping the stack.
+ */
+void *stack_alloc(size_t size);
+
+/*
+ * stack_free - Release a thread stack
+ * @stack: Stack returned by stack_alloc()
+ * @size: Size given to stack_alloc()
+ *
+ * Put @stack back into the pool of its class, or unmap it if it is larger
+ * than STACK_MAX_POOLED or if the pool is full. No thread may be running on
+ * @stack anymore.
+ *
+ * Return: -1 if @stack is NULL or if @size is 0. 0 if @stack was successfully
+ * released.
+ */
+int stack_free(void *stack, size_t size);
+
+/*
+ * stack_pool_trim - Empty the pool
+ *
+ * Unmap all the stacks currently pooled.
+ *
+ * Return: Number of stacks unmapped.
+ */
+int stack_pool_trim(void);
+
+/*
+ * stack_attr_init - Initialize thread attributes with a pooled stack
+ * @attr: Attributes to initialize
+ * @size: Minimum size of the stack in bytes
+ *
+ * Initialize @attr like pthread_attr_init() does, and make it use a stack
+ * allocated with stack_alloc(). @size is rounded up to the size of its class,
+ * so that the thread can use the whole stack. @attr can only be used to
+ * create a single thread, and the stack is released by stack_attr_destroy()
+ * once that thread has been joined.
+ *
+ * Return: -1 if @attr is NULL, if @size is less than PTHREAD_STACK_MIN, or in
+ * case of failure when allocating the stack. 0 if @attr was successfully
+ * initialized.
+ */
+int stack_attr_init(pthread_attr_t *attr, size_t size);
+
+/*
+ * stack_attr_destroy - Destroy thread attributes with a pooled stack
+ * @attr: Attributes initialized by stack_attr_init()
+ *
+ * Release the stack of @attr with stack_free(), then destroy @attr like
+ * pthread_attr_destroy() does. The thread created with @attr, if any, must
+ * have been joined.
+ *
+ * Return: -1 if @attr is NULL or has no stack. 0 if @attr was successfully
+ * destroyed.
+ */
+int stack_attr_destroy(pthread_attr_t *attr);
+
+#endif /* _STACK_H */
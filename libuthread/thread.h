@@ -45,4 +45,49 @@ void enter_critical_section(void);
  */
 void exit_critical_section(void);
 
+/*
+ * Traced builds (`make TRACE=1`) and profiled builds (`make CSPROF=1`) route
+ * the library's calls to the functions above through wrappers, recording
+ * blocking and critical section events (see trace.c) or timing the critical
+ * section per call site (see csprof.c). The wrappers of the profiler call the
+ * ones of the tracer when both are enabled.
+ */
+#ifdef UTHREAD_TRACE
+int traceThreadBlock(void);
+int traceThreadUnblock(pthread_t tid);
+void traceEnterCriticalSection(void);
+void traceExitCriticalSection(void);
+#endif
+
+#ifdef CS_PROFILE
+#include "csprof.h"
+
+void csprofEnter(struct csprof_site *site);
+void csprofExit(void);
+int csprofThreadBlock(void);
+#endif
+
+/* Defined by the wrappers themselves, to call the wrapped functions */
+#ifndef THREAD_NO_WRAP
+#ifdef UTHREAD_TRACE
+#define thread_unblock traceThreadUnblock
+#endif
+
+#if defined(CS_PROFILE)
+#define enter_critical_section()                                  \
+	do                                                            \
+	{                                                             \
+		static struct csprof_site site_ = {                       \
+			__func__, __FILE__, __LINE__};                        \
+		csprofEnter(&site_);                                      \
+	} while (0)
+#define exit_critical_section csprofExit
+#define thread_block csprofThreadBlock
+#elif defined(UTHREAD_TRACE)
+#define enter_critical_section traceEnterCriticalSection
+#define exit_critical_section traceExitCriticalSection
+#define thread_block traceThreadBlock
+#endif
+#endif
+
 #endif /* _THREAD_H */
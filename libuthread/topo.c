@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "topo.h"
+
+#define MAX_CPUS CPU_SETSIZE
+#define CACHE_ATTR "/sys/devices/system/cpu/cpu%d/cache/index%u/%s"
+
+static int llcId[MAX_CPUS]; /* lowest cpu sharing the llc, -1 if unknown */
+static pthread_once_t llcOnce = PTHREAD_ONCE_INIT;
+
+/* Read attribute @name of cache @index of cpu @cpu into @buf */
+static int readAttr(int cpu, unsigned int index, const char *name, char *buf,
+					size_t size)
+{
+	char path[128];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), CACHE_ATTR, cpu, index, name);
+
+	f = fopen(path, "r");
+
+	if (f == NULL)
+	{
+		return -1;
+	}
+
+	ret = fgets(buf, size, f) != NULL ? 0 : -1;
+	fclose(f);
+
+	return ret;
+}
+
+/* Parse a list of cpus such as "0-3,8-11" into @set */
+static void parseList(const char *list, cpu_set_t *set)
+{
+	char *end;
+	long first, last;
+
+	CPU_ZERO(set);
+
+	while (*list != '\0' && *list != '\n')
+	{
+		first = strtol(list, &end, 10);
+		last = first;
+
+		if (end == list)
+		{
+			break;
+		}
+
+		if (*end == '-')
+		{
+			list = end + 1;
+			last = strtol(list, &end, 10);
+		}
+
+		for (; first <= last && first < MAX_CPUS; first++)
+		{
+			CPU_SET(first, set);
+		}
+
+		list = *end == ',' ? end + 1 : end;
+	}
+}
+
+/* Get the cpus sharing cache of level @level (0 for the last) of cpu @cpu */
+static int cacheSet(int cpu, unsigned int level, cpu_set_t *set)
+{
+	unsigned int index, found = 0, bestIndex = 0, bestLevel = 0, cur;
+	char buf[256];
+
+	if (cpu < 0 || cpu >= MAX_CPUS)
+	{
+		return -1;
+	}
+
+	for (index = 0; readAttr(cpu, index, "type", buf, sizeof(buf)) == 0;
+		 index++)
+	{
+		if (strncmp(buf, "Instruction", 11) == 0 ||
+			readAttr(cpu, index, "level", buf, sizeof(buf)) == -1)
+		{
+			continue;
+		}
+
+		cur = strtoul(buf, NULL, 10);
+
+		if (level == 0 ? cur >= bestLevel : cur == level)
+		{
+			found = 1;
+			bestIndex = index;
+			bestLevel = cur;
+		}
+	}
+
+	if (!found ||
+		readAttr(cpu, bestIndex, "shared_cpu_list", buf, sizeof(buf)) == -1)
+	{
+		return -1;
+	}
+
+	parseList(buf, set);
+
+	return 0;
+}
+
+/* Lowest cpu of @set */
+static int firstCpu(const cpu_set_t *set)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++)
+	{
+		if (CPU_ISSET(cpu, set))
+		{
+			return cpu;
+		}
+	}
+
+	return -1;
+}
+
+static void readLlcIds(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	cpu_set_t set;
+	int cpu;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++)
+	{
+		llcId[cpu] = -1;
+
+		if (cpu < ncpus && cacheSet(cpu, 0, &set) == 0)
+		{
+			llcId[cpu] = firstCpu(&set);
+		}
+	}
+}
+
+int topo_cache_cpus(int cpu, unsigned int level, int *cpus, size_t max)
+{
+	cpu_set_t set;
+	size_t n = 0;
+	int i;
+
+	if (cpus == NULL || cacheSet(cpu, level, &set) == -1)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < MAX_CPUS; i++)
+	{
+		if (CPU_ISSET(i, &set))
+		{
+			if (n < max)
+			{
+				cpus[n] = i;
+			}
+
+			n++;
+		}
+	}
+
+	return n;
+}
+
+int topo_share_cache(int cpu1, int cpu2)
+{
+	if (cpu1 < 0 || cpu1 >= MAX_CPUS || cpu2 < 0 || cpu2 >= MAX_CPUS)
+	{
+		return 0;
+	}
+
+	if (cpu1 == cpu2)
+	{
+		return 1;
+	}
+
+	pthread_once(&llcOnce, readLlcIds);
+
+	return llcId[cpu1] != -1 && llcId[cpu1] == llcId[cpu2];
+}
+
+/* Get the cpus sharing cache of level @level with @cpu, or @cpu alone */
+static void domain(int cpu, unsigned int level, cpu_set_t *set)
+{
+	if (cacheSet(cpu, level, set) == -1)
+	{
+		CPU_ZERO(set);
+		CPU_SET(cpu, set);
+	}
+}
+
+int topo_place_stages(const pthread_t *threads, size_t count)
+{
+	int order[MAX_CPUS]; /* allowed cpus, grouped by llc then by l2 */
+	cpu_set_t allowed, placed, llc, l2, set;
+	int n = 0, c1, c2, c3, cpu;
+	size_t i;
+
+	if (threads == NULL || count == 0 ||
+		sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+	{
+		return -1;
+	}
+
+	CPU_ZERO(&placed);
+
+	for (c1 = 0; c1 < MAX_CPUS; c1++)
+	{
+		if (!CPU_ISSET(c1, &allowed) || CPU_ISSET(c1, &placed))
+		{
+			continue;
+		}
+
+		domain(c1, 0, &llc);
+
+		for (c2 = c1; c2 < MAX_CPUS; c2++)
+		{
+			if (!CPU_ISSET(c2, &llc) || !CPU_ISSET(c2, &allowed) ||
+				CPU_ISSET(c2, &placed))
+			{
+				continue;
+			}
+
+			domain(c2, 2, &l2);
+
+			for (c3 = c2; c3 < MAX_CPUS; c3++)
+			{
+				if (CPU_ISSET(c3, &l2) && CPU_ISSET(c3, &llc) &&
+					CPU_ISSET(c3, &allowed) && !CPU_ISSET(c3, &placed))
+				{
+					CPU_SET(c3, &placed);
+					order[n++] = c3;
+				}
+			}
+		}
+	}
+
+	if (n == 0)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		/* one stage per cpu if possible, contiguous blocks otherwise */
+		cpu = count <= (size_t)n ? order[i] : order[i * n / count];
+
+		domain(cpu, 2, &l2);
+		CPU_AND(&set, &l2, &allowed);
+
+		if (pthread_setaffinity_np(threads[i], sizeof(set), &set) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef _TOPO_H
+#define _TOPO_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * CPU cache topology, as described by /sys/devices/system/cpu
+ *
+ * Threads handing data to each other (e.g. the stages of a pipeline connected
+ * by semaphores) run faster on cpus sharing a cache, since the data does not
+ * have to travel between caches at every hand-off.
+ */
+
+/*
+ * topo_cache_cpus - Get the cpus sharing a cache
+ * @cpu: Cpu whose cache to consider
+ * @level: Level of the cache (e.g. 2 for L2), 0 for the last-level cache
+ * @cpus: Array receiving the cpus sharing the cache, in increasing order
+ * @max: Size of @cpus
+ *
+ * Fill @cpus with the cpus sharing the data (or unified) cache of level @level
+ * of cpu @cpu, @cpu included. At most @max cpus are stored.
+ *
+ * Return: -1 if @cpus is NULL, or if the topology of @cpu is unknown or has no
+ * such cache. Number of cpus sharing the cache otherwise (which can be more
+ * than @max).
+ */
+int topo_cache_cpus(int cpu, unsigned int level, int *cpus, size_t max);
+
+/*
+ * topo_share_cache - Check whether two cpus share their last-level cache
+ * @cpu1: First cpu
+ * @cpu2: Second cpu
+ *
+ * The topology is read once, which makes this function cheap enough to be
+ * called on hot paths.
+ *
+ * Return: 1 if @cpu1 and @cpu2 share their last-level cache (or if they are
+ * the same cpu), 0 otherwise or if the topology is unknown.
+ */
+int topo_share_cache(int cpu1, int cpu2);
+
+/*
+ * topo_place_stages - Place pipeline stages close to each other
+ * @threads: Threads running the stages, in pipeline order
+ * @count: Number of threads
+ *
+ * Restrict the threads of @threads to cpus chosen so that consecutive stages
+ * share as much cache as possible: allowed cpus are ordered by last-level
+ * cache, then by L2 cache, and the stages are laid out along this order, in
+ * contiguous blocks if there are more stages than cpus. Each thread is allowed
+ * to run on all the cpus sharing the L2 cache of its chosen cpu, so that the
+ * system can still balance load between them.
+ *
+ * Return: -1 if @threads is NULL, if @count is 0, or if the affinity of a
+ * thread could not be set. 0 if all the threads were successfully placed.
+ */
+int topo_place_stages(const pthread_t *threads, size_t count);
+
+#endif /* _TOPO_H */
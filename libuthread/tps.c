@@ -6,16 +6,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "lz.h"
+#include "pagecopy.h"
 #include "queue.h"
 #include "thread.h"
 #include "tps.h"
+#include "trace_probe.h"
 
 struct Page
 {
 	void *_pageAddr; /* address to the start of page */
 	int _refCount;   /* count number of TPS referencing to this page */
+	uint64_t _lastAccess; /* time of the last read or write, in ns */
+	void *_frozen;		  /* compressed content if reclaimed, NULL otherwise */
+	size_t _frozenSize;	  /* size of the compressed content */
 } Page;
 
 typedef struct Page *page_t;
@@ -24,6 +31,9 @@ struct TPS
 {
 	pthread_t _tid;
 	page_t _page;
+	queue_handle_t _handle; /* entry in tpsQueue */
+	struct tps_range _dirty[TPS_DIRTY_MAX_RANGES]; /* sorted, disjoint */
+	size_t _dirtyCount;
 } TPS;
 
 typedef struct TPS *tps_t;
@@ -31,6 +41,254 @@ typedef struct TPS *tps_t;
 queue_t tpsQueue; /* queue of tps structs */
 int init = 0;	 /* check if the TPS library has been initialized */
 
+/*
+ * Reclaiming idle pages: pages are compressed into a malloc'ed buffer and
+ * their memory is released with MADV_DONTNEED, the mapping itself being kept
+ * so that page addresses do not change. Pages are restored by tps_read() and
+ * tps_write() before accessing them. Everything happens within the critical
+ * section.
+ */
+#define TPS_RECLAIM_MAX_SIZE (TPS_SIZE / 2) /* keep pages compressing worse */
+
+struct tps_reclaim_stats reclaimStats;
+
+struct reclaimer
+{
+	pthread_t _tid;
+	pthread_mutex_t _lock;
+	pthread_cond_t _cond;
+	int _running;
+	unsigned int _idleMs;
+} reclaimer = {
+	._lock = PTHREAD_MUTEX_INITIALIZER,
+	._cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Coarse monotonic time in nanoseconds, good enough to track idleness */
+static uint64_t coarseNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Restore page @page if it was reclaimed, and record an access to it. Return -1
+ * if its compressed content is corrupted, in which case it stays reclaimed.
+ */
+static int thawPage(page_t page)
+{
+	struct timespec start, end;
+	long size;
+
+	if (page->_frozen != NULL)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+
+		/* the decompressor reads back what it already wrote */
+		mprotect(page->_pageAddr, TPS_SIZE, PROT_READ | PROT_WRITE);
+		size = lzDecompress(page->_frozen, page->_frozenSize,
+							page->_pageAddr, TPS_SIZE);
+		mprotect(page->_pageAddr, TPS_SIZE, PROT_NONE);
+
+		if (size != TPS_SIZE)
+		{
+			madvise(page->_pageAddr, TPS_SIZE, MADV_DONTNEED);
+			return -1;
+		}
+
+		free(page->_frozen);
+		page->_frozen = NULL;
+
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		reclaimStats.reclaimed_pages--;
+		reclaimStats.compressed_bytes -= page->_frozenSize;
+		reclaimStats.cold_accesses++;
+		reclaimStats.cold_access_ns +=
+			(uint64_t)(end.tv_sec - start.tv_sec) * 1000000000 +
+			end.tv_nsec - start.tv_nsec;
+	}
+
+	page->_lastAccess = coarseNow();
+
+	return 0;
+}
+
+/* Compress page @page and release its memory, return 1 if it was reclaimed */
+static int freezePage(page_t page)
+{
+	char buffer[TPS_RECLAIM_MAX_SIZE];
+	size_t size;
+
+	mprotect(page->_pageAddr, TPS_SIZE, PROT_READ);
+	size = lzCompress(page->_pageAddr, TPS_SIZE, buffer, sizeof(buffer));
+	mprotect(page->_pageAddr, TPS_SIZE, PROT_NONE);
+
+	if (size == 0 || (page->_frozen = malloc(size)) == NULL)
+	{
+		/* don't try again before the page has been idle for long again */
+		page->_lastAccess = coarseNow();
+		return 0;
+	}
+
+	memcpy(page->_frozen, buffer, size);
+	page->_frozenSize = size;
+	madvise(page->_pageAddr, TPS_SIZE, MADV_DONTNEED);
+
+	reclaimStats.reclaimed_pages++;
+	reclaimStats.compressed_bytes += size;
+
+	return 1;
+}
+
+struct reclaimArgs
+{
+	uint64_t _before; /* reclaim pages last accessed before this time */
+	int _count;		  /* number of pages reclaimed */
+};
+
+/* Callback function that reclaims the page of a tps if idle */
+int reclaimTPSPage(void *data, void *arg)
+{
+	tps_t tps = (tps_t)data;
+	struct reclaimArgs *args = (struct reclaimArgs *)arg;
+
+	/* a page shared by several TPS is only visited once while not frozen */
+	if (tps->_page->_frozen == NULL &&
+		tps->_page->_lastAccess <= args->_before)
+	{
+		args->_count += freezePage(tps->_page);
+	}
+
+	return 0;
+}
+
+/* Background reclaimer thread */
+static void *reclaimLoop(void *arg)
+{
+	unsigned int periodMs = reclaimer._idleMs / 2;
+	struct timespec deadline;
+
+	(void)arg;
+
+	if (periodMs == 0)
+	{
+		periodMs = 1;
+	}
+	else if (periodMs > 1000)
+	{
+		periodMs = 1000;
+	}
+
+	pthread_mutex_lock(&reclaimer._lock);
+
+	while (reclaimer._running)
+	{
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += periodMs / 1000;
+		deadline.tv_nsec += (long)(periodMs % 1000) * 1000000;
+
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		if (pthread_cond_timedwait(&reclaimer._cond, &reclaimer._lock,
+								   &deadline) == 0)
+		{
+			continue; /* woken up by tps_reclaim_stop() */
+		}
+
+		pthread_mutex_unlock(&reclaimer._lock);
+		tps_reclaim(reclaimer._idleMs);
+		pthread_mutex_lock(&reclaimer._lock);
+	}
+
+	pthread_mutex_unlock(&reclaimer._lock);
+
+	return NULL;
+}
+
+/* mark the whole area of @tps as dirty */
+static void markAllDirty(tps_t tps)
+{
+	tps->_dirty[0].offset = 0;
+	tps->_dirty[0].length = TPS_SIZE;
+	tps->_dirtyCount = 1;
+}
+
+/* merge the two consecutive dirty ranges of @tps with the smallest gap */
+static void mergeClosestRanges(tps_t tps)
+{
+	struct tps_range *r = tps->_dirty;
+	size_t i, best = 0, gap, bestGap = SIZE_MAX;
+
+	for (i = 0; i + 1 < tps->_dirtyCount; i++)
+	{
+		gap = r[i + 1].offset - (r[i].offset + r[i].length);
+
+		if (gap < bestGap)
+		{
+			best = i;
+			bestGap = gap;
+		}
+	}
+
+	r[best].length = r[best + 1].offset + r[best + 1].length - r[best].offset;
+	memmove(&r[best + 1], &r[best + 2],
+			(tps->_dirtyCount - best - 2) * sizeof(struct tps_range));
+	tps->_dirtyCount--;
+}
+
+/* add the @length bytes at @offset to the dirty ranges of @tps */
+static void markDirty(tps_t tps, size_t offset, size_t length)
+{
+	struct tps_range *r = tps->_dirty;
+	size_t start = offset, end = offset + length;
+	size_t i, j;
+
+	if (length == 0)
+	{
+		return;
+	}
+
+	while (1)
+	{
+		/* ranges i to j - 1 overlap or touch the new one */
+		for (i = 0; i < tps->_dirtyCount && r[i].offset + r[i].length < start;
+			 i++)
+			;
+		for (j = i; j < tps->_dirtyCount && r[j].offset <= end; j++)
+			;
+
+		if (j > i || tps->_dirtyCount < TPS_DIRTY_MAX_RANGES)
+		{
+			break;
+		}
+
+		mergeClosestRanges(tps); /* no room for one more range */
+	}
+
+	if (j > i)
+	{
+		start = r[i].offset < start ? r[i].offset : start;
+		end = r[j - 1].offset + r[j - 1].length > end
+				  ? r[j - 1].offset + r[j - 1].length
+				  : end;
+	}
+
+	/* replace ranges i to j - 1 with a single one */
+	memmove(&r[i + 1], &r[j], (tps->_dirtyCount - j) * sizeof(struct tps_range));
+	tps->_dirtyCount = tps->_dirtyCount - (j - i) + 1;
+
+	r[i].offset = start;
+	r[i].length = end - start;
+}
+
 /* Callback function that finds the tps */
 int findTPS(void *data, void *arg)
 {
@@ -172,6 +430,9 @@ int tps_create(void)
 	newTPS->_page->_refCount = 1;
 	newTPS->_page->_pageAddr = mmap(NULL, TPS_SIZE,
 									PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	newTPS->_page->_lastAccess = coarseNow();
+	newTPS->_page->_frozen = NULL;
+	markAllDirty(newTPS);
 
 	if (newTPS->_page->_pageAddr == NULL)
 	{
@@ -180,7 +441,7 @@ int tps_create(void)
 
 	enter_critical_section();
 
-	queue_enqueue(tpsQueue, newTPS);
+	queue_enqueue_handle(tpsQueue, newTPS, &newTPS->_handle);
 
 	exit_critical_section();
 
@@ -208,6 +469,13 @@ int tps_destroy(void)
 	if (tps->_page->_refCount == 1)
 	{
 		/* remove page structure if not shared with other threads */
+		if (tps->_page->_frozen != NULL)
+		{
+			reclaimStats.reclaimed_pages--;
+			reclaimStats.compressed_bytes -= tps->_page->_frozenSize;
+			free(tps->_page->_frozen);
+		}
+
 		munmap(tps->_page->_pageAddr, TPS_SIZE); /* remove TPS area */
 		free(tps->_page);
 		tps->_page = NULL;
@@ -217,7 +485,7 @@ int tps_destroy(void)
 		tps->_page->_refCount--; /* remove reference to the page memory */
 	}
 
-	queue_delete(tpsQueue, tps); /* remove node from queue */
+	queue_delete_handle(tpsQueue, tps->_handle); /* remove node from queue */
 
 	exit_critical_section();
 
@@ -241,11 +509,25 @@ int tps_read(size_t offset, size_t length, char *buffer)
 
 	enter_critical_section();
 
-	mprotect(tps->_page->_pageAddr + offset, length, PROT_READ); /* allow read */
+	if (thawPage(tps->_page) == -1)
+	{
+		exit_critical_section();
+		return -1;
+	}
 
-	memcpy(buffer, tps->_page->_pageAddr + offset, length); /* read from TPS area */
+	mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_READ); /* allow read */
 
-	mprotect(tps->_page->_pageAddr + offset, length, PROT_NONE); /* reset */
+	/* read from TPS area */
+	if (length == TPS_SIZE)
+	{
+		pageCopy(buffer, tps->_page->_pageAddr);
+	}
+	else
+	{
+		memcpy(buffer, tps->_page->_pageAddr + offset, length);
+	}
+
+	mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_NONE); /* reset */
 
 	exit_critical_section();
 
@@ -269,10 +551,18 @@ int tps_write(size_t offset, size_t length, char *buffer)
 
 	enter_critical_section();
 
+	if (thawPage(tps->_page) == -1)
+	{
+		exit_critical_section();
+		return -1;
+	}
+
 	if (tps->_page->_refCount > 1)
 	{
 		/* the page is shared, so need to create a new one */
 
+		TRACE(TRACE_TPS_COW_BEGIN, tps->_page);
+
 		tps->_page->_refCount -= 1; /* decrement reference count */
 
 		page_t newPage = malloc(sizeof(Page));
@@ -280,27 +570,39 @@ int tps_write(size_t offset, size_t length, char *buffer)
 		newPage->_refCount = 1;
 		newPage->_pageAddr = mmap(NULL, TPS_SIZE,
 								  PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		newPage->_lastAccess = coarseNow();
+		newPage->_frozen = NULL;
 
 		/* clone content from the old page */
 
 		mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_READ);
 		mprotect(newPage->_pageAddr, TPS_SIZE, PROT_WRITE);
 
-		memcpy(newPage->_pageAddr, tps->_page->_pageAddr, TPS_SIZE);
+		pageCopy(newPage->_pageAddr, tps->_page->_pageAddr);
 
 		mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_NONE);
-		mprotect(newPage->_pageAddr, TPS_SIZE, PROT_NONE);
 
 		tps->_page = newPage;
+
+		TRACE(TRACE_TPS_COW_END, newPage);
 	}
 
 	/* begin writing to TPS area */
 
-	mprotect(tps->_page->_pageAddr + offset, length, PROT_WRITE);
+	mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_WRITE);
+
+	if (length == TPS_SIZE)
+	{
+		pageCopy(tps->_page->_pageAddr, buffer);
+	}
+	else
+	{
+		memcpy(tps->_page->_pageAddr + offset, buffer, length);
+	}
 
-	memcpy(tps->_page->_pageAddr + offset, buffer, length);
+	mprotect(tps->_page->_pageAddr, TPS_SIZE, PROT_NONE);
 
-	mprotect(tps->_page->_pageAddr + offset, length, PROT_NONE);
+	markDirty(tps, offset, length);
 
 	exit_critical_section();
 
@@ -342,8 +644,145 @@ int tps_clone(pthread_t tid)
 	newTPS->_page = srcTPS->_page;
 
 	newTPS->_page->_refCount += 1; /* increment reference count */
+	markAllDirty(newTPS);
+
+	queue_enqueue_handle(tpsQueue, newTPS, &newTPS->_handle);
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int tps_dirty_ranges(struct tps_range *ranges, size_t max)
+{
+	tps_t tps = NULL;
+	size_t n;
+
+	if (!init || ranges == NULL || max == 0 ||
+		!hasTPSBeenAllocated(pthread_self(), &tps))
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	n = tps->_dirtyCount < max ? tps->_dirtyCount : max;
+	memcpy(ranges, tps->_dirty, n * sizeof(struct tps_range));
+
+	if (n > 0 && n < tps->_dirtyCount)
+	{
+		/* extend the last range over the ones that do not fit */
+		ranges[n - 1].length = tps->_dirty[tps->_dirtyCount - 1].offset +
+							   tps->_dirty[tps->_dirtyCount - 1].length -
+							   ranges[n - 1].offset;
+	}
+
+	exit_critical_section();
+
+	return n;
+}
+
+int tps_clear_dirty(void)
+{
+	tps_t tps = NULL;
+
+	if (!init || !hasTPSBeenAllocated(pthread_self(), &tps))
+	{
+		return -1;
+	}
+
+	enter_critical_section();
+
+	tps->_dirtyCount = 0;
+
+	exit_critical_section();
+
+	return 0;
+}
+
+int tps_reclaim(unsigned int idle_ms)
+{
+	struct reclaimArgs args;
+
+	if (!init)
+	{
+		return -1;
+	}
+
+	args._before = coarseNow() - (uint64_t)idle_ms * 1000000;
+	args._count = 0;
+
+	enter_critical_section();
+
+	queue_iterate(tpsQueue, reclaimTPSPage, &args, NULL);
+
+	exit_critical_section();
+
+	return args._count;
+}
+
+int tps_reclaim_start(unsigned int idle_ms)
+{
+	int ret = 0;
+
+	if (!init || idle_ms == 0)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&reclaimer._lock);
+
+	if (reclaimer._running)
+	{
+		ret = -1;
+	}
+	else
+	{
+		reclaimer._running = 1;
+		reclaimer._idleMs = idle_ms;
+
+		if (pthread_create(&reclaimer._tid, NULL, reclaimLoop, NULL) != 0)
+		{
+			reclaimer._running = 0;
+			ret = -1;
+		}
+	}
+
+	pthread_mutex_unlock(&reclaimer._lock);
+
+	return ret;
+}
+
+int tps_reclaim_stop(void)
+{
+	pthread_mutex_lock(&reclaimer._lock);
+
+	if (!reclaimer._running)
+	{
+		pthread_mutex_unlock(&reclaimer._lock);
+		return -1;
+	}
+
+	reclaimer._running = 0;
+	pthread_cond_signal(&reclaimer._cond);
+
+	pthread_mutex_unlock(&reclaimer._lock);
+
+	pthread_join(reclaimer._tid, NULL);
+
+	return 0;
+}
+
+int tps_get_reclaim_stats(struct tps_reclaim_stats *stats)
+{
+	if (!init || stats == NULL)
+	{
+		return -1;
+	}
+
+	enter_critical_section();
 
-	queue_enqueue(tpsQueue, newTPS);
+	*stats = reclaimStats;
 
 	exit_critical_section();
 
@@ -92,4 +92,117 @@ int tps_write(size_t offset, size_t length, char *buffer);
  */
 int tps_clone(pthread_t tid);
 
+/*
+ * Maximum number of dirty ranges tracked per TPS
+ */
+#define TPS_DIRTY_MAX_RANGES 16
+
+/*
+ * struct tps_range - Range of bytes of a TPS area
+ *
+ * @offset: Offset of the first byte of the range
+ * @length: Number of bytes in the range
+ */
+struct tps_range {
+	size_t offset;
+	size_t length;
+};
+
+/*
+ * tps_dirty_ranges - Get the dirty ranges of TPS
+ * @ranges: Array receiving the dirty ranges, in increasing order of offset
+ * @max: Size of @ranges
+ *
+ * Get the ranges of the current thread's TPS written by tps_write() since the
+ * last call to tps_clear_dirty(), so that a copy of the TPS can be brought up
+ * to date by only copying these ranges. A new TPS, created or cloned, starts
+ * out entirely dirty.
+ *
+ * Overlapping and adjacent writes are merged into a single range. When more
+ * than TPS_DIRTY_MAX_RANGES distinct ranges have been written, the closest
+ * ones get merged together, their gap being considered dirty as well. In the
+ * same way, if there are more than @max ranges, the last one stored in
+ * @ranges is extended to cover the remaining ones. The ranges always cover
+ * all the bytes written.
+ *
+ * Return: -1 if current thread doesn't have a TPS, if @ranges is NULL, or if
+ * @max is 0. Number of ranges stored in @ranges otherwise.
+ */
+int tps_dirty_ranges(struct tps_range *ranges, size_t max);
+
+/*
+ * tps_clear_dirty - Mark TPS as clean
+ *
+ * Forget the dirty ranges of the current thread's TPS, typically once they
+ * have been copied. Only the writes happening afterwards are reported by
+ * tps_dirty_ranges().
+ *
+ * Return: -1 if current thread doesn't have a TPS. 0 if the TPS was
+ * successfully marked as clean.
+ */
+int tps_clear_dirty(void);
+
+/*
+ * tps_reclaim - Reclaim idle TPS pages
+ * @idle_ms: Minimum time since the last access to a page, in milliseconds
+ *
+ * Compress the content of every TPS page that has been neither read nor
+ * written for at least @idle_ms milliseconds into a compact in-memory store,
+ * and release the page's memory to the system. A reclaimed page is
+ * transparently restored upon its next access through tps_read() or
+ * tps_write(). Pages whose content does not compress well are left alone.
+ *
+ * Return: -1 if the TPS API has not been initialized. Number of pages
+ * reclaimed otherwise.
+ */
+int tps_reclaim(unsigned int idle_ms);
+
+/*
+ * tps_reclaim_start - Start reclaiming idle TPS pages in the background
+ * @idle_ms: Minimum time since the last access to a page, in milliseconds
+ *
+ * Start a background thread calling tps_reclaim() with @idle_ms every
+ * @idle_ms / 2 milliseconds (and at least every second).
+ *
+ * Return: -1 if the TPS API has not been initialized, if @idle_ms is 0, if the
+ * background reclaimer is already running, or in case of failure when starting
+ * it. 0 if the background reclaimer was successfully started.
+ */
+int tps_reclaim_start(unsigned int idle_ms);
+
+/*
+ * tps_reclaim_stop - Stop reclaiming idle TPS pages in the background
+ *
+ * Stop the background thread started by tps_reclaim_start(). Pages already
+ * reclaimed remain so until accessed.
+ *
+ * Return: -1 if the background reclaimer is not running. 0 if it was
+ * successfully stopped.
+ */
+int tps_reclaim_stop(void);
+
+/*
+ * struct tps_reclaim_stats - TPS reclaiming statistics
+ *
+ * @reclaimed_pages: Number of pages currently reclaimed
+ * @compressed_bytes: Memory used by the compressed content of these pages
+ * @cold_accesses: Number of accesses to reclaimed pages so far
+ * @cold_access_ns: Total time spent restoring reclaimed pages upon access
+ */
+struct tps_reclaim_stats {
+	size_t reclaimed_pages;
+	size_t compressed_bytes;
+	uint64_t cold_accesses;
+	uint64_t cold_access_ns;
+};
+
+/*
+ * tps_get_reclaim_stats - Get TPS reclaiming statistics
+ * @stats: Address of structure receiving the statistics
+ *
+ * Return: -1 if the TPS API has not been initialized or if @stats is NULL. 0
+ * if @stats was successfully filled.
+ */
+int tps_get_reclaim_stats(struct tps_reclaim_stats *stats);
+
 #endif /* _TPS_H */
@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#define THREAD_NO_WRAP
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "thread.h"
+#include "trace.h"
+#include "trace_probe.h"
+
+#ifdef UTHREAD_TRACE
+
+/*
+ * Events are timestamped with the time stamp counter where there is one, it
+ * being twice as fast to read as the monotonic clock, and converted to time
+ * when dumped
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ticks() __rdtsc()
+#else
+#define ticks() clockNs()
+#endif
+
+#define TRACE_RING_SIZE 4096 /* events kept per thread, a power of two */
+
+struct event
+{
+	uint64_t _ts;	  /* ticks() when recorded */
+	const void *_obj; /* object the event is about */
+	int _type;		  /* enum traceEvent */
+	pid_t _tid;		  /* kernel thread id of the thread recording it */
+};
+
+/*
+ * Ring buffer of the most recent events of a thread. Only its thread writes
+ * events, publishing them by incrementing the head, so recording takes no
+ * lock. When the thread exits, the ring is handed over to the next new thread,
+ * which keeps on recording after the events of the previous owner.
+ */
+struct ring
+{
+	struct ring *_next;		/* next in the list of all rings */
+	struct ring *_nextFree; /* next in the list of rings of exited threads */
+	pid_t _tid;				/* kernel thread id of the owner */
+	pthread_t _self;		/* pthread id of the owner */
+	int _exited;			/* whether the owner has exited */
+	uint64_t _head;			/* number of events recorded */
+	struct event _events[TRACE_RING_SIZE];
+};
+
+static const struct
+{
+	const char *name;
+	const char *cat;
+	char ph; /* B(egin) or E(nd) of a duration, i(nstant) */
+} kinds[TRACE_EVENTS] = {
+	[TRACE_SEM_DOWN_BEGIN] = {"sem_down", "sem", 'B'},
+	[TRACE_SEM_DOWN_END] = {"sem_down", "sem", 'E'},
+	[TRACE_SEM_UP] = {"sem_up", "sem", 'i'},
+	[TRACE_BLOCK] = {"blocked", "thread", 'B'},
+	[TRACE_WAKE] = {"blocked", "thread", 'E'},
+	[TRACE_UNBLOCK] = {"unblock", "thread", 'i'},
+	[TRACE_CS_ENTER] = {"critical_section", "thread", 'B'},
+	[TRACE_CS_EXIT] = {"critical_section", "thread", 'E'},
+	[TRACE_TPS_COW_BEGIN] = {"tps_cow", "tps", 'B'},
+	[TRACE_TPS_COW_END] = {"tps_cow", "tps", 'E'},
+};
+
+static pthread_mutex_t ringsLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ring *rings;	  /* all rings, protected by ringsLock */
+static struct ring *freeRings; /* rings of exited threads, same */
+
+static __thread struct ring *ring; /* ring of the calling thread */
+static __thread int inside;		   /* whether it holds the critical section */
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ringKey; /* to know when threads exit */
+
+/* Reference point to convert ticks to time, taken with the first event */
+static uint64_t baseTicks, baseNs;
+
+static uint64_t clockNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* Hand the ring of an exiting thread over to the next new thread */
+static void releaseRing(void *arg)
+{
+	struct ring *r = arg;
+
+	ring = NULL;
+
+	pthread_mutex_lock(&ringsLock);
+	r->_exited = 1;
+	r->_nextFree = freeRings;
+	freeRings = r;
+	pthread_mutex_unlock(&ringsLock);
+}
+
+static void createKey(void)
+{
+	pthread_key_create(&ringKey, releaseRing);
+
+	baseNs = clockNs();
+	baseTicks = ticks();
+}
+
+/* Get a ring for the calling thread, NULL if out of memory */
+static struct ring *acquireRing(void)
+{
+	struct ring *r;
+
+	pthread_once(&keyOnce, createKey);
+
+	pthread_mutex_lock(&ringsLock);
+
+	r = freeRings != NULL ? freeRings : malloc(sizeof(struct ring));
+
+	if (r != NULL)
+	{
+		if (r == freeRings)
+		{
+			freeRings = r->_nextFree;
+		}
+		else
+		{
+			r->_next = rings;
+			rings = r;
+			r->_head = 0;
+		}
+
+		r->_tid = syscall(SYS_gettid);
+		r->_self = pthread_self();
+		r->_exited = 0;
+	}
+
+	pthread_mutex_unlock(&ringsLock);
+
+	if (r != NULL)
+	{
+		ring = r;
+		pthread_setspecific(ringKey, r);
+	}
+
+	return r;
+}
+
+void traceRecord(enum traceEvent type, const void *obj)
+{
+	struct ring *r = ring;
+
+	if (r == NULL && (r = acquireRing()) == NULL)
+	{
+		return;
+	}
+
+	uint64_t head = __atomic_load_n(&r->_head, __ATOMIC_RELAXED);
+	struct event *e = &r->_events[head & (TRACE_RING_SIZE - 1)];
+
+	e->_ts = ticks();
+	e->_obj = obj;
+	e->_type = type;
+	e->_tid = r->_tid;
+
+	/* publish the event */
+	__atomic_store_n(&r->_head, head + 1, __ATOMIC_RELEASE);
+}
+
+int traceThreadBlock(void)
+{
+	/* the critical section is left while blocked */
+	traceRecord(TRACE_CS_EXIT, NULL);
+	traceRecord(TRACE_BLOCK, NULL);
+
+	int ret = thread_block();
+
+	traceRecord(TRACE_WAKE, NULL);
+	traceRecord(TRACE_CS_ENTER, NULL);
+
+	return ret;
+}
+
+int traceThreadUnblock(pthread_t tid)
+{
+	traceRecord(TRACE_UNBLOCK, (const void *)tid);
+
+	return thread_unblock(tid);
+}
+
+void traceEnterCriticalSection(void)
+{
+	if (inside)
+	{
+		/* the critical section is not recursive: a nested pair of events
+		 * would show the inner exit as leaving it */
+		fprintf(stderr, "trace: critical section already entered by thread "
+						"%ld\n",
+				(long)syscall(SYS_gettid));
+		abort();
+	}
+
+	/* the wait to enter is part of the section */
+	traceRecord(TRACE_CS_ENTER, NULL);
+	enter_critical_section();
+	inside = 1;
+}
+
+void traceExitCriticalSection(void)
+{
+	inside = 0;
+	exit_critical_section();
+	traceRecord(TRACE_CS_EXIT, NULL);
+}
+
+/*
+ * Kernel thread id of thread @self, 0 if unknown. Pthread ids being reused, a
+ * live thread is preferred to an exited one.
+ */
+static pid_t kernelTid(pthread_t self)
+{
+	struct ring *r;
+	pid_t tid = 0;
+
+	for (r = rings; r != NULL; r = r->_next)
+	{
+		if (pthread_equal(r->_self, self))
+		{
+			if (!r->_exited)
+			{
+				return r->_tid;
+			}
+
+			tid = r->_tid;
+		}
+	}
+
+	return tid;
+}
+
+static void dumpEvent(FILE *stream, const struct event *e, double nsPerTick,
+					  long count)
+{
+	int type = e->_type;
+	uint64_t ns = baseNs + (int64_t)(e->_ts - baseTicks) * nsPerTick;
+
+	fprintf(stream, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+					"\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%d",
+			count > 0 ? ",\n" : "", kinds[type].name, kinds[type].cat,
+			kinds[type].ph, (unsigned long long)(ns / 1000),
+			(unsigned int)(ns % 1000), (int)getpid(), (int)e->_tid);
+
+	if (kinds[type].ph == 'i')
+	{
+		fprintf(stream, ",\"s\":\"t\"");
+	}
+
+	if (type == TRACE_UNBLOCK)
+	{
+		fprintf(stream, ",\"args\":{\"tid\":%d}",
+				(int)kernelTid((pthread_t)e->_obj));
+	}
+	else if (e->_obj != NULL)
+	{
+		fprintf(stream, ",\"args\":{\"obj\":\"%p\"}", e->_obj);
+	}
+
+	fprintf(stream, "}");
+}
+
+#endif
+
+long trace_dump(FILE *stream)
+{
+#ifdef UTHREAD_TRACE
+	struct ring *r;
+	double nsPerTick = 1;
+	long count = 0;
+
+	if (stream == NULL)
+	{
+		return -1;
+	}
+
+	pthread_mutex_lock(&ringsLock);
+
+	if (rings != NULL)
+	{
+		uint64_t ns = clockNs(), now = ticks();
+
+		if (now != baseTicks)
+		{
+			nsPerTick = (double)(ns - baseNs) / (now - baseTicks);
+		}
+	}
+
+	fprintf(stream, "{\"traceEvents\":[\n");
+
+	for (r = rings; r != NULL; r = r->_next)
+	{
+		uint64_t head = __atomic_load_n(&r->_head, __ATOMIC_ACQUIRE);
+		uint64_t i = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+		for (; i < head; i++)
+		{
+			dumpEvent(stream, &r->_events[i & (TRACE_RING_SIZE - 1)],
+					  nsPerTick, count++);
+		}
+	}
+
+	fprintf(stream, "\n]}\n");
+
+	pthread_mutex_unlock(&ringsLock);
+
+	return count;
+#else
+	return -1;
+#endif
+}
+
+int trace_reset(void)
+{
+#ifdef UTHREAD_TRACE
+	struct ring *r;
+
+	pthread_mutex_lock(&ringsLock);
+
+	for (r = rings; r != NULL; r = r->_next)
+	{
+		__atomic_store_n(&r->_head, 0, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&ringsLock);
+
+	return 0;
+#else
+	return -1;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdio.h>
+
+/*
+ * Event tracing
+ *
+ * When the library is built with tracing (`make TRACE=1`), every kernel thread
+ * records the events of the library it goes through (semaphore operations,
+ * blocking and unblocking, critical sections, TPS copy-on-write) with their
+ * timestamps into a ring buffer of its own, holding its most recent events.
+ * The ring of an exited thread is handed over to the next new thread, so its
+ * events are kept until they get overwritten. Uthreads are traced as the
+ * worker running them. Otherwise, the probes are compiled out and the
+ * functions below fail.
+ *
+ * The critical section is not recursive: a thread entering it again before
+ * leaving it makes traced builds abort.
+ */
+
+/*
+ * trace_dump - Print the recorded events
+ * @stream: Stream to print to
+ *
+ * Print the events currently held by the ring buffers of all the threads that
+ * have recorded any, in the Chrome trace event JSON format (to be loaded into
+ * chrome://tracing or Perfetto). Threads should not be recording events
+ * meanwhile, or some of these could be garbled.
+ *
+ * Return: -1 if @stream is NULL or if tracing is disabled. Number of events
+ * printed otherwise.
+ */
+long trace_dump(FILE *stream);
+
+/*
+ * trace_reset - Forget the recorded events
+ *
+ * Empty the ring buffers of all threads. Same restriction as trace_dump().
+ *
+ * Return: -1 if tracing is disabled. 0 otherwise.
+ */
+int trace_reset(void);
+
+#endif /* _TRACE_H */
@@ -0,0 +1,32 @@
+#ifndef _TRACE_PROBE_H
+#define _TRACE_PROBE_H
+
+/*
+ * Tracing probes, for internal use by the library
+ */
+
+enum traceEvent
+{
+	TRACE_SEM_DOWN_BEGIN,
+	TRACE_SEM_DOWN_END,
+	TRACE_SEM_UP,
+	TRACE_BLOCK,
+	TRACE_WAKE,
+	TRACE_UNBLOCK,
+	TRACE_CS_ENTER,
+	TRACE_CS_EXIT,
+	TRACE_TPS_COW_BEGIN,
+	TRACE_TPS_COW_END,
+	TRACE_EVENTS
+};
+
+#ifdef UTHREAD_TRACE
+/* Record event @type about object @obj in the ring of the calling thread */
+void traceRecord(enum traceEvent type, const void *obj);
+
+#define TRACE(type, obj) traceRecord(type, obj)
+#else
+#define TRACE(type, obj) ((void)0)
+#endif
+
+#endif /* _TRACE_PROBE_H */
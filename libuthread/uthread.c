@@ -0,0 +1,498 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#include "cqueue.h"
+#include "futex.h"
+#include "sem.h"
+#include "stack.h"
+#include "thread.h"
+#include "uthread.h"
+#include "uthread_sched.h"
+
+#define UTHREAD_STACK_SIZE (64 * 1024)
+
+/*
+ * Runnable uthreads wait in a single lock-free run queue shared by all the
+ * workers. Idle workers sleep on an event count (_seq), bumped each time a
+ * uthread is made runnable.
+ *
+ * A uthread always switches back to the context of its worker, never directly
+ * to another uthread, and leaves it an action to perform once it is completely
+ * switched out (e.g. requeueing it, or leaving the critical section it parked
+ * in). This way, a uthread can never be resumed by a worker while another one
+ * is still running on its stack.
+ *
+ * Compilers may keep the address of thread-local variables in registers, which
+ * goes stale when a uthread migrates from one worker to another. Uthread code
+ * therefore only uses the thread-local worker before its first switch, and
+ * reaches its current worker through the uthread itself afterwards.
+ */
+
+#if defined(__x86_64__)
+/* saved stack pointer, the other registers are saved on the stack */
+typedef void *context_t;
+
+/*
+ * Save the callee-saved registers on the current stack and the stack pointer
+ * in *@from, then restore the context whose stack pointer is @to.
+ */
+void uthreadSwitch(context_t *from, context_t to);
+
+__asm__(".text\n"
+		".globl uthreadSwitch\n"
+		".hidden uthreadSwitch\n"
+		".type uthreadSwitch, @function\n"
+		"uthreadSwitch:\n"
+		"	pushq %rbp\n"
+		"	pushq %rbx\n"
+		"	pushq %r12\n"
+		"	pushq %r13\n"
+		"	pushq %r14\n"
+		"	pushq %r15\n"
+		"	movq %rsp, (%rdi)\n"
+		"	movq %rsi, %rsp\n"
+		"	popq %r15\n"
+		"	popq %r14\n"
+		"	popq %r13\n"
+		"	popq %r12\n"
+		"	popq %rbx\n"
+		"	popq %rbp\n"
+		"	ret\n"
+		".size uthreadSwitch, .-uthreadSwitch\n");
+#else
+typedef ucontext_t context_t;
+#endif
+
+/* what a worker does once the uthread it ran has switched back to it */
+enum action
+{
+	ACTION_YIELD, /* requeue the uthread */
+	ACTION_PARK,  /* leave the critical section the uthread parked in */
+	ACTION_EXIT,  /* let joiners know the uthread is over */
+};
+
+/* consecutive uthreads a worker runs out of its own slot before the queue */
+#define MAX_AFFINE_RUNS 64
+
+struct worker
+{
+	context_t _context;		  /* scheduling loop */
+	struct uthread *_current; /* uthread being run */
+	struct uthread *_next;	  /* woken up by this worker, to run next */
+	unsigned int _affineRuns; /* uthreads run in a row out of _next */
+	enum action _action;
+	pthread_t _tid;
+};
+
+struct uthread
+{
+	context_t _context;		 /* saved while switched out */
+	struct worker *_worker;	 /* worker running the uthread */
+	void *_stack;			 /* pooled, see stack.h */
+	uthread_func_t _func;
+	void *_arg;
+	void *_ret;
+	sem_t _done; /* posted when the uthread is over */
+};
+
+static struct
+{
+	cqueue_t _runQueue;
+	uint32_t _seq;	/* event count of runnable uthreads */
+	uint32_t _idle; /* number of sleeping workers */
+	size_t _nworkers;
+	struct worker *_workers;
+} runtime;
+
+static pthread_mutex_t initLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct worker *self; /* worker of the current thread */
+
+static void switchContext(context_t *from, context_t *to)
+{
+#if defined(__x86_64__)
+	uthreadSwitch(from, *to);
+#else
+	swapcontext(from, to);
+#endif
+}
+
+/* Switch from uthread @ut back to its worker, which will perform @action */
+static void switchOut(struct uthread *ut, enum action action)
+{
+	ut->_worker->_action = action;
+	switchContext(&ut->_context, &ut->_worker->_context);
+}
+
+/* Make @ut runnable by any worker */
+static void makeRunnable(struct uthread *ut)
+{
+	/* the run queue is unbounded, it can only fail when out of memory */
+	while (cqueue_enqueue(runtime._runQueue, ut) == -1)
+	{
+		sched_yield();
+	}
+
+	__atomic_fetch_add(&runtime._seq, 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&runtime._idle, __ATOMIC_SEQ_CST) > 0)
+	{
+		futex_wake(&runtime._seq, 1, 0);
+	}
+}
+
+/* Take the uthread a busy worker other than the caller was to run next */
+static struct uthread *stealNext(void)
+{
+	struct worker *workers;
+	struct uthread *ut;
+	size_t i;
+
+	/* published once all the workers are started */
+	workers = __atomic_load_n(&runtime._workers, __ATOMIC_ACQUIRE);
+
+	for (i = 0; workers != NULL && i < runtime._nworkers; i++)
+	{
+		if (&workers[i] == self)
+		{
+			continue;
+		}
+
+		ut = __atomic_exchange_n(&workers[i]._next, NULL, __ATOMIC_SEQ_CST);
+
+		if (ut != NULL)
+		{
+			return ut;
+		}
+	}
+
+	return NULL;
+}
+
+/* Get the next runnable uthread, sleeping until there is one */
+static struct uthread *nextRunnable(void)
+{
+	struct uthread *ut;
+	uint32_t seq;
+
+	while (1)
+	{
+		if (cqueue_dequeue(runtime._runQueue, (void **)&ut) == 0)
+		{
+			return ut;
+		}
+
+		seq = __atomic_load_n(&runtime._seq, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add(&runtime._idle, 1, __ATOMIC_SEQ_CST);
+
+		/*
+		 * Check again now that wakers know we are about to sleep, also in the
+		 * slots of the other workers, which could keep a uthread there for
+		 * as long as their current one runs (see uthreadWake())
+		 */
+		if (cqueue_dequeue(runtime._runQueue, (void **)&ut) == 0 ||
+			(ut = stealNext()) != NULL)
+		{
+			__atomic_fetch_sub(&runtime._idle, 1, __ATOMIC_SEQ_CST);
+			return ut;
+		}
+
+		futex_wait(&runtime._seq, seq, NULL, 0);
+		__atomic_fetch_sub(&runtime._idle, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+static void *workerLoop(void *arg)
+{
+	struct worker *w = (struct worker *)arg;
+	struct uthread *ut;
+
+	self = w;
+
+	while (1)
+	{
+		ut = __atomic_exchange_n(&w->_next, NULL, __ATOMIC_SEQ_CST);
+
+		if (ut != NULL && w->_affineRuns++ == MAX_AFFINE_RUNS)
+		{
+			/* let the queued uthreads run, uthreads waking up each other
+			 * would otherwise keep this worker to themselves */
+			makeRunnable(ut);
+			ut = NULL;
+		}
+
+		if (ut == NULL)
+		{
+			w->_affineRuns = 0;
+			ut = nextRunnable();
+		}
+
+		ut->_worker = w;
+		w->_current = ut;
+		switchContext(&w->_context, &ut->_context);
+		w->_current = NULL;
+
+		switch (w->_action)
+		{
+		case ACTION_YIELD:
+			makeRunnable(ut);
+			break;
+		case ACTION_PARK:
+			exit_critical_section();
+			break;
+		case ACTION_EXIT:
+			sem_up(ut->_done);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/* Entry point of every uthread */
+static void start(void)
+{
+	struct uthread *ut = self->_current;
+
+	ut->_ret = ut->_func(ut->_arg);
+	switchOut(ut, ACTION_EXIT);
+}
+
+/* Prepare the initial context of @ut, so that it starts in start() */
+static void makeContext(struct uthread *ut)
+{
+	char *top = (char *)ut->_stack + UTHREAD_STACK_SIZE;
+
+#if defined(__x86_64__)
+	void **sp = (void **)((uintptr_t)top & ~(uintptr_t)15);
+	int i;
+
+	/*
+	 * Pretend start() was called (leaving a null return address), and that
+	 * uthreadSwitch() was then called from its very beginning with all the
+	 * callee-saved registers zeroed.
+	 */
+	*--sp = NULL;
+	*--sp = (void *)start;
+	sp -= 6;
+	for (i = 0; i < 6; i++)
+	{
+		sp[i] = NULL;
+	}
+
+	ut->_context = sp;
+#else
+	getcontext(&ut->_context);
+	ut->_context.uc_stack.ss_sp = ut->_stack;
+	ut->_context.uc_stack.ss_size = UTHREAD_STACK_SIZE;
+	ut->_context.uc_link = NULL;
+	makecontext(&ut->_context, start, 0);
+#endif
+}
+
+int uthread_init(size_t workers)
+{
+	struct worker *w;
+	size_t i;
+
+	pthread_mutex_lock(&initLock);
+
+	if (runtime._workers != NULL)
+	{
+		pthread_mutex_unlock(&initLock);
+		return -1;
+	}
+
+	if (workers == 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		workers = cpus > 0 ? cpus : 1;
+	}
+
+	runtime._runQueue = cqueue_create(0);
+	w = calloc(workers, sizeof(struct worker));
+
+	if (runtime._runQueue == NULL || w == NULL)
+	{
+		cqueue_destroy(runtime._runQueue);
+		free(w);
+		pthread_mutex_unlock(&initLock);
+		return -1;
+	}
+
+	for (i = 0; i < workers; i++)
+	{
+		if (pthread_create(&w[i]._tid, NULL, workerLoop, &w[i]) != 0)
+		{
+			break;
+		}
+	}
+
+	/* workers can't be stopped, settle for those which could be started */
+	if (i == 0)
+	{
+		cqueue_destroy(runtime._runQueue);
+		free(w);
+		pthread_mutex_unlock(&initLock);
+		return -1;
+	}
+
+	runtime._nworkers = i;
+	__atomic_store_n(&runtime._workers, w, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&initLock);
+
+	return 0;
+}
+
+uthread_t uthread_create(uthread_func_t func, void *arg)
+{
+	struct uthread *ut;
+
+	if (func == NULL)
+	{
+		return NULL;
+	}
+
+	if (__atomic_load_n(&runtime._workers, __ATOMIC_ACQUIRE) == NULL)
+	{
+		/* fails harmlessly if another thread started the runtime first */
+		uthread_init(0);
+
+		if (__atomic_load_n(&runtime._workers, __ATOMIC_ACQUIRE) == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	ut = malloc(sizeof(struct uthread));
+
+	if (ut == NULL)
+	{
+		return NULL;
+	}
+
+	ut->_stack = stack_alloc(UTHREAD_STACK_SIZE);
+	ut->_done = sem_create(0);
+
+	if (ut->_stack == NULL || ut->_done == NULL)
+	{
+		stack_free(ut->_stack, UTHREAD_STACK_SIZE);
+		sem_destroy(ut->_done);
+		free(ut);
+		return NULL;
+	}
+
+	ut->_func = func;
+	ut->_arg = arg;
+	ut->_ret = NULL;
+	ut->_worker = NULL;
+	makeContext(ut);
+
+	makeRunnable(ut);
+
+	return ut;
+}
+
+int uthread_join(uthread_t ut, void **retval)
+{
+	if (ut == NULL || ut == uthread_self())
+	{
+		return -1;
+	}
+
+	sem_down(ut->_done);
+
+	if (retval != NULL)
+	{
+		*retval = ut->_ret;
+	}
+
+	sem_destroy(ut->_done);
+	stack_free(ut->_stack, UTHREAD_STACK_SIZE);
+	free(ut);
+
+	return 0;
+}
+
+void uthread_yield(void)
+{
+	struct uthread *ut = uthread_self();
+
+	if (ut == NULL)
+	{
+		sched_yield();
+		return;
+	}
+
+	switchOut(ut, ACTION_YIELD);
+}
+
+void uthread_exit(void *retval)
+{
+	struct uthread *ut = uthread_self();
+
+	if (ut == NULL)
+	{
+		return;
+	}
+
+	ut->_ret = retval;
+	switchOut(ut, ACTION_EXIT);
+}
+
+uthread_t uthread_self(void)
+{
+	return self != NULL ? self->_current : NULL;
+}
+
+void uthreadPark(void)
+{
+	struct uthread *ut = self->_current;
+
+	switchOut(ut, ACTION_PARK);
+
+	/* possibly on another worker now */
+	enter_critical_section();
+}
+
+void uthreadWake(uthread_t ut, int affine)
+{
+	struct uthread *prev;
+
+	if (!affine || self == NULL)
+	{
+		makeRunnable(ut);
+		return;
+	}
+
+	/* the latest wake-up runs next, the previous one goes to the queue */
+	prev = __atomic_exchange_n(&self->_next, ut, __ATOMIC_SEQ_CST);
+
+	if (prev != NULL)
+	{
+		makeRunnable(prev);
+	}
+
+	/*
+	 * Unless a worker is idle: it should rather run @ut right away than wait
+	 * for this one to be done with its current uthread. Pairs with the
+	 * increment of _idle in nextRunnable(), either side sees the other.
+	 */
+	if (__atomic_load_n(&runtime._idle, __ATOMIC_SEQ_CST) > 0)
+	{
+		ut = __atomic_exchange_n(&self->_next, NULL, __ATOMIC_SEQ_CST);
+
+		if (ut != NULL)
+		{
+			makeRunnable(ut);
+		}
+	}
+}
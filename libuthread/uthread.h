@@ -0,0 +1,93 @@
+#ifndef _UTHREAD_H
+#define _UTHREAD_H
+
+#include <stddef.h>
+
+/*
+ * uthread_t - User-level thread type
+ *
+ * User-level threads (uthreads) are lightweight threads multiplexed over a
+ * fixed pool of kernel threads (workers). Switching between uthreads happens
+ * entirely in user space, and so does blocking: a uthread calling sem_down()
+ * on an unavailable semaphore is parked and its worker picks up another
+ * runnable uthread, until sem_up() makes the parked uthread runnable again.
+ *
+ * Uthreads share their worker's kernel thread identity. Functions that rely on
+ * it (e.g. pthread_self(), the TPS API, or blocking on primitives other than
+ * semaphores) see, or block, the whole worker.
+ */
+typedef struct uthread *uthread_t;
+
+/*
+ * uthread_func_t - Uthread function type
+ * @arg: Argument given to uthread_create()
+ *
+ * Return: Value received by uthread_join()
+ */
+typedef void *(*uthread_func_t)(void *arg);
+
+/*
+ * uthread_init - Start the runtime
+ * @workers: Number of worker kernel threads, 0 for one per online cpu
+ *
+ * Start the worker threads running uthreads. Calling this function is
+ * optional, the runtime starts with the default number of workers upon the
+ * first call to uthread_create() otherwise.
+ *
+ * Return: -1 if the runtime was already started, or in case of failure when
+ * starting it. 0 if the runtime was successfully started.
+ */
+int uthread_init(size_t workers);
+
+/*
+ * uthread_create - Create a uthread
+ * @func: Function to run in the new uthread
+ * @arg: Argument to pass to @func
+ *
+ * Create a new uthread running @func(@arg) and make it runnable. The uthread
+ * ends when @func returns or when it calls uthread_exit(), and must then be
+ * joined with uthread_join() to release its resources.
+ *
+ * Return: The new uthread. NULL if @func is NULL or in case of failure when
+ * allocating the uthread.
+ */
+uthread_t uthread_create(uthread_func_t func, void *arg);
+
+/*
+ * uthread_join - Wait for a uthread to end
+ * @ut: Uthread to wait for
+ * @retval: (Optional) Address of pointer receiving the return value of @ut
+ *
+ * Wait until uthread @ut ends, then release its resources. May be called from
+ * uthreads (which are parked while waiting) as well as from regular threads.
+ *
+ * Return: -1 if @ut is NULL or is the calling uthread. 0 if @ut was
+ * successfully joined.
+ */
+int uthread_join(uthread_t ut, void **retval);
+
+/*
+ * uthread_yield - Yield the worker
+ *
+ * Put the calling uthread at the back of the run queue and let its worker run
+ * another uthread. When called from a regular thread, yield the cpu instead.
+ */
+void uthread_yield(void);
+
+/*
+ * uthread_exit - End the calling uthread
+ * @retval: Return value of the uthread
+ *
+ * End the calling uthread as if its function returned @retval. Does nothing
+ * when called from a regular thread.
+ */
+void uthread_exit(void *retval);
+
+/*
+ * uthread_self - Get the calling uthread
+ *
+ * Return: The calling uthread. NULL if called from a regular thread.
+ */
+uthread_t uthread_self(void);
+
+#endif /* _UTHREAD_H */
@@ -0,0 +1,25 @@
+#ifndef _UTHREAD_SCHED_H
+#define _UTHREAD_SCHED_H
+
+#include "uthread.h"
+
+/*
+ * Uthread scheduling, for internal use by the blocking primitives
+ */
+
+/*
+ * Park the calling uthread until uthreadWake() is called on it. Must be called
+ * within the critical section, entered exactly once: like thread_block(), the
+ * critical section is exited once the uthread is switched out, and re-entered
+ * upon wake-up.
+ */
+void uthreadPark(void);
+
+/*
+ * Make parked uthread @ut runnable again. If @affine is different than 0 and
+ * the caller runs on a worker, @ut is run next by that worker rather than by
+ * whichever worker dequeues it first, unless another worker is idle.
+ */
+void uthreadWake(uthread_t ut, int affine);
+
+#endif /* _UTHREAD_SCHED_H */
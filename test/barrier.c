@@ -0,0 +1,135 @@
+/*
+ * Barrier and latch test
+ *
+ * Threads go through several phases separated by a barrier, each publishing
+ * its phase number before arriving: after the barrier, every thread must see
+ * the others' numbers for that phase. The average duration of a phase
+ * transition is reported. A latch is then counted down by workers, including
+ * work added on the fly, while the main thread waits for it.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <barrier.h>
+
+#define NTHREADS	16
+#define MAXTHREADS	256
+#define NPHASES		1000
+
+static barrier_t barrier;
+static latch_t latch;
+static volatile unsigned int phases[MAXTHREADS];
+static unsigned int nthreads = NTHREADS, nphases = NPHASES;
+static int serial;
+
+static void *phaser(void *arg)
+{
+	int id = (int)(long)arg;
+	unsigned int phase, i;
+
+	for (phase = 1; phase <= nphases; phase++) {
+		phases[id] = phase;
+		if (barrier_wait(barrier) == 1)
+			__atomic_add_fetch(&serial, 1, __ATOMIC_RELAXED);
+		for (i = 0; i < nthreads; i++)
+			assert(phases[i] >= phase);
+		/* nobody may start the next phase before everyone checked */
+		barrier_wait(barrier);
+	}
+
+	return NULL;
+}
+
+static void *worker(void *arg)
+{
+	int id = (int)(long)arg;
+
+	/* even workers discover an extra piece of work */
+	if (id % 2 == 0) {
+		assert(latch_add(latch, 1) == 0);
+		assert(latch_count_down(latch, 1) == 0);
+	}
+	assert(latch_count_down(latch, 1) == 0);
+
+	return NULL;
+}
+
+static void test_barrier(void)
+{
+	pthread_t tid[nthreads];
+	struct timespec start, end;
+	unsigned int i;
+
+	assert(barrier_create(0) == NULL);
+	barrier = barrier_create(nthreads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&tid[i], NULL, phaser, (void*)(long)i);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%u threads, %u phases: %.1f us/phase\n", nthreads, nphases,
+	       ((end.tv_sec - start.tv_sec) * 1e6 +
+		(end.tv_nsec - start.tv_nsec) / 1e3) / (2.0 * nphases));
+	assert(serial == (int)nphases);
+	assert(barrier_destroy(barrier) == 0);
+}
+
+static void test_latch(void)
+{
+	pthread_t tid[nthreads];
+	unsigned int i;
+
+	latch = latch_create(nthreads + 1);
+	assert(latch_try_wait(latch) == -1);
+	assert(latch_count_down(latch, nthreads + 2) == -1);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_create(&tid[i], NULL, worker, (void*)(long)i);
+
+	assert(latch_arrive_and_wait(latch) == 0);
+	assert(latch_try_wait(latch) == 0);
+	assert(latch_add(latch, 1) == -1);
+	assert(latch_arrive_and_wait(latch) == -1);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(tid[i], NULL);
+	assert(latch_destroy(latch) == 0);
+
+	/* a latch created at zero is already released */
+	latch = latch_create(0);
+	assert(latch_wait(latch) == 0);
+	assert(latch_destroy(latch) == 0);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1)
+		nthreads = get_argv(argv[1]);
+	if (argc > 2)
+		nphases = get_argv(argv[2]);
+	if (nthreads > MAXTHREADS)
+		nthreads = MAXTHREADS;
+
+	test_barrier();
+	test_latch();
+
+	return 0;
+}
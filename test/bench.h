@@ -0,0 +1,92 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+/*
+ * Helpers shared by the benchmark programs
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Monotonic timestamp in nanoseconds */
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Burn roughly @n iterations of cpu without touching memory */
+static inline void bench_spin(unsigned int n)
+{
+	volatile unsigned int i;
+
+	for (i = 0; i < n; i++)
+		;
+}
+
+static inline int bench_compare(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile @p of the @n sorted samples at @sorted */
+static inline double bench_percentile(const double *sorted, size_t n, double p)
+{
+	size_t rank = (size_t)(p / 100 * n + 0.999999);
+
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+ * Results are printed as a JSON array with one object per line, each one
+ * describing the distribution of the samples of a benchmark, e.g.:
+ *
+ * [
+ * {"name": "sem/uncontended", "unit": "ns/op", "samples": 200, ...},
+ * ...
+ * ]
+ */
+static int bench_results __attribute__((unused)); /* printed so far */
+
+static inline void bench_json_begin(void)
+{
+	printf("[\n");
+	bench_results = 0;
+}
+
+static inline void bench_json_end(void)
+{
+	printf("\n]\n");
+}
+
+/* Print the distribution of the @n @samples of benchmark @name, sorting them */
+static inline void bench_json(const char *name, const char *unit,
+			      double *samples, size_t n)
+{
+	double sum = 0;
+	size_t i;
+
+	if (n == 0)
+		return;
+
+	qsort(samples, n, sizeof(double), bench_compare);
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+
+	printf("%s{\"name\": \"%s\", \"unit\": \"%s\", \"samples\": %zu, "
+	       "\"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+	       "\"max\": %.1f, \"mean\": %.1f}", bench_results++ ? ",\n" : "",
+	       name, unit, n, samples[0], bench_percentile(samples, n, 50),
+	       bench_percentile(samples, n, 90),
+	       bench_percentile(samples, n, 99), samples[n - 1], sum / n);
+	fflush(stdout);
+}
+
+#endif /* _BENCH_H */
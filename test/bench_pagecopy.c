@@ -0,0 +1,122 @@
+/*
+ * TPS page copy benchmark
+ *
+ * Measures the cycles taken by the page copy kernels of each instruction set,
+ * on a page hot in the cache and over a working set larger than the cache,
+ * then the time spent in tps_write() (nearly all of it within the critical
+ * section) for whole-area writes and for copy-on-write of a cloned page.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#define UNIT "cycles"
+#else
+#define cycles() bench_now()
+#define UNIT "ns"
+#endif
+
+#include <pagecopy.h>
+#include <tps.h>
+
+#include "bench.h"
+
+#define HOT_ROUNDS	100000
+#define COLD_PAGES	8192 /* 32 MiB */
+#define WRITES		20000
+#define CLONES		2000
+
+static const char *isas[] = { "libc", "sse2", "avx2" };
+
+static char *src, *dst;
+static char page[TPS_SIZE];
+static pthread_t owner;
+
+static void kernels(const char *isa)
+{
+	uint64_t start, hot, cold;
+	int i;
+
+	start = cycles();
+	for (i = 0; i < HOT_ROUNDS; i++)
+		pageCopy(dst, src);
+	hot = (cycles() - start) / HOT_ROUNDS;
+
+	start = cycles();
+	for (i = 0; i < COLD_PAGES; i++)
+		pageCopy(dst + (size_t)i * TPS_SIZE, src + (size_t)i * TPS_SIZE);
+	cold = (cycles() - start) / COLD_PAGES;
+
+	printf("%-5s %6lu %s/page hot %6lu cold\n", isa, (unsigned long)hot,
+	       UNIT, (unsigned long)cold);
+}
+
+static void *cloner(void *arg)
+{
+	uint64_t *elapsed = arg;
+	uint64_t start;
+
+	tps_clone(owner);
+
+	/* copy-on-write of the whole page, then a one-byte write */
+	start = bench_now();
+	tps_write(0, 1, page);
+	*elapsed += bench_now() - start;
+
+	tps_destroy();
+
+	return NULL;
+}
+
+static void transfers(const char *isa)
+{
+	uint64_t start, write, cow = 0;
+	pthread_t tid;
+	int i;
+
+	start = bench_now();
+	for (i = 0; i < WRITES; i++)
+		tps_write(0, TPS_SIZE, page);
+	write = (bench_now() - start) / WRITES;
+
+	for (i = 0; i < CLONES; i++) {
+		pthread_create(&tid, NULL, cloner, &cow);
+		pthread_join(tid, NULL);
+	}
+
+	printf("%-5s %6lu ns/whole-area write %6lu ns/copy-on-write\n", isa,
+	       (unsigned long)write, (unsigned long)(cow / CLONES));
+}
+
+int main(void)
+{
+	size_t i;
+
+	src = aligned_alloc(TPS_SIZE, (size_t)COLD_PAGES * TPS_SIZE);
+	dst = aligned_alloc(TPS_SIZE, (size_t)COLD_PAGES * TPS_SIZE);
+	memset(src, 1, (size_t)COLD_PAGES * TPS_SIZE);
+	memset(dst, 2, (size_t)COLD_PAGES * TPS_SIZE);
+
+	for (i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+		if (pageCopySelect(isas[i]) == 0)
+			kernels(isas[i]);
+
+	tps_init(0);
+	tps_create();
+	owner = pthread_self();
+
+	for (i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+		if (pageCopySelect(isas[i]) == 0)
+			transfers(isas[i]);
+
+	tps_destroy();
+	free(src);
+	free(dst);
+
+	return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Queue benchmark
+ *
+ * Compares the library's ring buffer queue with the original linked-list
+ * implementation (queue_orig.o, whose functions are renamed list_queue_* into
+ * queue_list.o when building) on the operations the library relies on:
+ * enqueue/dequeue pairs at a steady depth (wait lists), full iterations (TPS
+ * lookups) and deletions from the middle (waiters leaving a wait list, TPS
+ * areas being destroyed). The ring queue deletes by handle, the original one
+ * can only search by value.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <queue.h>
+
+#include "bench.h"
+
+#define PAIRS		10000000
+#define FIFO_DEPTH	16
+#define ITER_LENGTH	1000
+#define ITER_ROUNDS	20000
+#define DEL_LENGTH	1024
+#define DEL_ROUNDS	200000
+
+/* Original implementation */
+queue_t list_queue_create(void);
+int list_queue_destroy(queue_t queue);
+int list_queue_enqueue(queue_t queue, void *data);
+int list_queue_dequeue(queue_t queue, void **data);
+int list_queue_delete(queue_t queue, void *data);
+int list_queue_iterate(queue_t queue, queue_func_t func, void *arg,
+		       void **data);
+
+struct impl {
+	const char *name;
+	queue_t (*create)(void);
+	int (*destroy)(queue_t);
+	int (*enqueue)(queue_t, void *);
+	int (*dequeue)(queue_t, void **);
+	int (*delete)(queue_t, void *);
+	int (*iterate)(queue_t, queue_func_t, void *, void **);
+	int (*enqueue_handle)(queue_t, void *, queue_handle_t *);
+	int (*delete_handle)(queue_t, queue_handle_t);
+};
+
+static const struct impl impls[] = {
+	{ "list", list_queue_create, list_queue_destroy, list_queue_enqueue,
+	  list_queue_dequeue, list_queue_delete, list_queue_iterate,
+	  NULL, NULL },
+	{ "ring", queue_create, queue_destroy, queue_enqueue,
+	  queue_dequeue, queue_delete, queue_iterate,
+	  queue_enqueue_handle, queue_delete_handle },
+};
+
+static int sum(void *data, void *arg)
+{
+	*(size_t*)arg += (size_t)data;
+	return 0;
+}
+
+static void drain(const struct impl *q, queue_t queue)
+{
+	void *data;
+
+	while (q->dequeue(queue, &data) == 0)
+		;
+	q->destroy(queue);
+}
+
+static double bench_fifo(const struct impl *q)
+{
+	queue_t queue = q->create();
+	uint64_t start;
+	void *data;
+	size_t i;
+
+	for (i = 1; i <= FIFO_DEPTH; i++)
+		q->enqueue(queue, (void*)i);
+
+	start = bench_now();
+	for (i = 0; i < PAIRS; i++) {
+		q->dequeue(queue, &data);
+		q->enqueue(queue, data);
+	}
+	start = bench_now() - start;
+
+	drain(q, queue);
+
+	return (double)start / PAIRS;
+}
+
+static double bench_iterate(const struct impl *q)
+{
+	queue_t queue = q->create();
+	size_t i, total = 0;
+	uint64_t start;
+
+	for (i = 1; i <= ITER_LENGTH; i++)
+		q->enqueue(queue, (void*)i);
+
+	start = bench_now();
+	for (i = 0; i < ITER_ROUNDS; i++)
+		q->iterate(queue, sum, &total, NULL);
+	start = bench_now() - start;
+
+	if (total != (size_t)ITER_ROUNDS * ITER_LENGTH * (ITER_LENGTH + 1) / 2)
+		fprintf(stderr, "%s: bad iteration\n", q->name);
+
+	drain(q, queue);
+
+	return (double)start / ITER_ROUNDS / ITER_LENGTH;
+}
+
+static double bench_delete(const struct impl *q)
+{
+	static queue_handle_t handles[DEL_LENGTH + 1];
+	queue_t queue = q->create();
+	uint32_t rand = 2463534242u;
+	uint64_t start;
+	size_t i;
+
+	for (i = 1; i <= DEL_LENGTH; i++) {
+		if (q->enqueue_handle)
+			q->enqueue_handle(queue, (void*)i, &handles[i]);
+		else
+			q->enqueue(queue, (void*)i);
+	}
+
+	/* remove items from all over the queue and put them back at the end */
+	start = bench_now();
+	for (i = 0; i < DEL_ROUNDS; i++) {
+		size_t item;
+
+		rand ^= rand << 13;
+		rand ^= rand >> 17;
+		rand ^= rand << 5;
+		item = rand % DEL_LENGTH + 1;
+
+		if (q->delete_handle) {
+			q->delete_handle(queue, handles[item]);
+			q->enqueue_handle(queue, (void*)item, &handles[item]);
+		} else {
+			q->delete(queue, (void*)item);
+			q->enqueue(queue, (void*)item);
+		}
+	}
+	start = bench_now() - start;
+
+	drain(q, queue);
+
+	return (double)start / DEL_ROUNDS;
+}
+
+int main(void)
+{
+	size_t i;
+
+	printf("%-6s %14s %14s %14s\n", "impl", "fifo ns/pair",
+	       "iterate ns/item", "delete ns/op");
+
+	for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+		const struct impl *q = &impls[i];
+
+		printf("%-6s %14.2f %14.2f %14.2f\n", q->name, bench_fifo(q),
+		       bench_iterate(q), bench_delete(q));
+	}
+
+	return 0;
+}
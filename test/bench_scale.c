@@ -0,0 +1,255 @@
+/*
+ * Thread-count scaling harness
+ *
+ * Sweeps the number of live threads (and of cpus the process may run on),
+ * each thread owning a TPS and handing a semaphore back and forth with a
+ * partner thread between TPS accesses. At each point, reports as JSON the
+ * cost of creating the threads (including their TPS), the throughput and
+ * latency percentiles of TPS accesses and semaphore hand-offs, the resident
+ * memory and number of mappings with all threads alive, and the cost of
+ * tearing everything down.
+ *
+ * Since TPS areas are looked up in a list of all of them and blocked threads
+ * are kept in a list as well, the per-operation costs grow with the number of
+ * threads: the curves show how fast.
+ *
+ * Usage: bench_scale.x [max threads], 20000 by default. The sweep stops early
+ * if threads or mappings run out.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sem.h>
+#include <stack.h>
+#include <tps.h>
+
+#include "bench.h"
+
+#define STACK_SIZE	(64 * 1024)
+#define TOTAL_ROUNDS	100000 /* split among the threads of a point */
+#define SAMPLED		4      /* timed rounds per thread */
+#define MAPS_PER_THREAD	3      /* stack, guard page and TPS */
+
+static const int counts[] = { 10, 100, 1000, 5000, 10000, 20000, 50000 };
+
+struct worker {
+	pthread_t tid;
+	pthread_attr_t attr;
+	sem_t turn;
+	double tps[SAMPLED];	 /* latency of a write and a read */
+	double handoff[SAMPLED]; /* latency of a round trip with the partner */
+};
+
+static struct worker *workers;
+static int live, rounds;
+static sem_t ready, start, done;
+
+static void *run(void *arg)
+{
+	struct worker *w = arg, *partner;
+	char buffer[64] = "scaling";
+	uint64_t t0, t1, t2;
+	int i, id = w - workers;
+
+	if (tps_create() == -1)
+		abort();
+	sem_up(ready);
+	sem_down(start);
+
+	/* pairs of consecutive threads, the first one serving first */
+	partner = (id ^ 1) < live ? &workers[id ^ 1] : w;
+
+	for (i = 0; i < rounds; i++) {
+		t0 = bench_now();
+		tps_write(0, sizeof(buffer), buffer);
+		tps_read(0, sizeof(buffer), buffer);
+		t1 = bench_now();
+
+		if (id % 2 == 0) {
+			sem_up(partner->turn);
+			sem_down(w->turn);
+		} else {
+			sem_down(w->turn);
+			sem_up(partner->turn);
+		}
+		t2 = bench_now();
+
+		if (i < SAMPLED) {
+			w->tps[i] = t1 - t0;
+			w->handoff[i] = t2 - t1;
+		}
+	}
+
+	sem_up(done);
+	tps_destroy();
+
+	return NULL;
+}
+
+static long count_maps(void)
+{
+	FILE *f = fopen("/proc/self/maps", "r");
+	long n = 0;
+	int c;
+
+	if (f == NULL)
+		return -1;
+	while ((c = fgetc(f)) != EOF)
+		n += c == '\n';
+	fclose(f);
+
+	return n;
+}
+
+static long resident_kib(void)
+{
+	long size, rss = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	if (f != NULL) {
+		if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+			rss = 0;
+		fclose(f);
+	}
+
+	return rss * 4;
+}
+
+/* Run one point of the sweep, return -1 if the threads could not be created */
+static int point(int count, int cpus, double *samples)
+{
+	uint64_t t0, t1, t2, t3;
+	long rss, maps;
+	int i, n;
+
+	workers = calloc(count, sizeof(struct worker));
+	rounds = TOTAL_ROUNDS / count > SAMPLED ? TOTAL_ROUNDS / count : SAMPLED;
+	ready = sem_create(0);
+	start = sem_create(0);
+	done = sem_create(0);
+
+	t0 = bench_now();
+	for (live = 0; live < count; live++) {
+		struct worker *w = &workers[live];
+
+		w->turn = sem_create(0);
+		if (stack_attr_init(&w->attr, STACK_SIZE) == -1)
+			break;
+		if (pthread_create(&w->tid, &w->attr, run, w) != 0) {
+			stack_attr_destroy(&w->attr);
+			break;
+		}
+	}
+	for (i = 0; i < live; i++)
+		sem_down(ready);
+	t1 = bench_now();
+
+	rss = resident_kib();
+	maps = count_maps();
+
+	for (i = 0; i < live; i++)
+		sem_up(start);
+	for (i = 0; i < live; i++)
+		sem_down(done);
+	t2 = bench_now();
+
+	for (i = 0; i < live; i++) {
+		pthread_join(workers[i].tid, NULL);
+		stack_attr_destroy(&workers[i].attr);
+	}
+	t3 = bench_now();
+
+	printf("%s{\"threads\": %d, \"cpus\": %d, \"create_us\": %.1f, "
+	       "\"ops_per_s\": %.0f, ", bench_results++ ? ",\n" : "", live, cpus,
+	       (double)(t1 - t0) / live / 1000,
+	       (double)live * rounds * 1e9 / (t2 - t1));
+
+	n = 0;
+	for (i = 0; i < live; i++) {
+		memcpy(samples + n, workers[i].tps, sizeof(workers[i].tps));
+		n += SAMPLED;
+	}
+	qsort(samples, n, sizeof(double), bench_compare);
+	printf("\"tps_p50_ns\": %.0f, \"tps_p99_ns\": %.0f, ",
+	       bench_percentile(samples, n, 50),
+	       bench_percentile(samples, n, 99));
+
+	n = 0;
+	for (i = 0; i < live; i++) {
+		memcpy(samples + n, workers[i].handoff,
+		       sizeof(workers[i].handoff));
+		n += SAMPLED;
+	}
+	qsort(samples, n, sizeof(double), bench_compare);
+	printf("\"handoff_p50_ns\": %.0f, \"handoff_p99_ns\": %.0f, ",
+	       bench_percentile(samples, n, 50),
+	       bench_percentile(samples, n, 99));
+
+	printf("\"rss_kib\": %ld, \"maps\": %ld, \"teardown_us\": %.1f}", rss,
+	       maps, (double)(t3 - t2) / live / 1000);
+	fflush(stdout);
+
+	for (i = 0; i < count; i++)
+		sem_destroy(workers[i].turn);
+	sem_destroy(ready);
+	sem_destroy(start);
+	sem_destroy(done);
+	free(workers);
+
+	return live < count ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	int max = argc > 1 ? atoi(argv[1]) : 20000;
+	cpu_set_t allowed, set;
+	double *samples;
+	int cpus, ncpus, cpu, i, k;
+	FILE *f;
+
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	ncpus = CPU_COUNT(&allowed);
+
+	/* leave room for the mappings of the library and of the harness */
+	f = fopen("/proc/sys/vm/max_map_count", "r");
+	if (f != NULL) {
+		if (fscanf(f, "%d", &i) == 1 && i / MAPS_PER_THREAD - 1000 < max)
+			max = i / MAPS_PER_THREAD - 1000;
+		fclose(f);
+	}
+
+	samples = malloc((size_t)max * SAMPLED * sizeof(double));
+	tps_init(0);
+
+	bench_json_begin();
+
+	for (cpus = 1; ; cpus = cpus * 2 < ncpus ? cpus * 2 : ncpus) {
+		/* run on the first @cpus allowed cpus */
+		CPU_ZERO(&set);
+		for (cpu = 0, k = 0; k < cpus; cpu++) {
+			if (CPU_ISSET(cpu, &allowed)) {
+				CPU_SET(cpu, &set);
+				k++;
+			}
+		}
+		sched_setaffinity(0, sizeof(set), &set);
+
+		for (i = 0; i < (int)(sizeof(counts) / sizeof(counts[0])); i++) {
+			if (counts[i] > max || point(counts[i], cpus, samples) == -1)
+				break;
+		}
+
+		if (cpus == ncpus)
+			break;
+	}
+
+	bench_json_end();
+	free(samples);
+
+	return 0;
+}
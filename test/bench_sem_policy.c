@@ -0,0 +1,124 @@
+/*
+ * Semaphore policy benchmark
+ *
+ * Several threads repeatedly take a binary semaphore, do a little work while
+ * holding it, release it and do a little more work before taking it again.
+ * The benchmark is run once with the strict FIFO hand-off policy and once with
+ * the barging policy, and reports for each the total throughput along with how
+ * evenly acquisitions were spread among threads (Jain's fairness index: 1.0
+ * means perfectly even, 1/N means a single thread got everything).
+ */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sem.h>
+
+#include "bench.h"
+
+#define NTHREADS	4
+#define DURATION_MS	1000
+#define INSIDE_WORK	200
+#define OUTSIDE_WORK	50
+
+struct bench {
+	sem_t lock;
+	volatile int stop;
+	size_t shared;
+};
+
+struct worker {
+	struct bench *b;
+	size_t ops;
+	pthread_t tid;
+};
+
+static void *worker(void *arg)
+{
+	struct worker *w = (struct worker*)arg;
+	struct bench *b = w->b;
+
+	while (!b->stop) {
+		sem_down(b->lock);
+		b->shared++;
+		bench_spin(INSIDE_WORK);
+		sem_up(b->lock);
+		bench_spin(OUTSIDE_WORK);
+		w->ops++;
+	}
+
+	return NULL;
+}
+
+static void run(const char *name, sem_policy_t policy, unsigned int nthreads,
+		unsigned int duration_ms)
+{
+	struct bench b;
+	struct worker *w = calloc(nthreads, sizeof(*w));
+	uint64_t start, elapsed;
+	double sum = 0, sumsq = 0;
+	size_t min = SIZE_MAX, max = 0;
+	unsigned int i;
+
+	b.lock = sem_create_policy(1, policy);
+	b.stop = 0;
+	b.shared = 0;
+
+	start = bench_now();
+	for (i = 0; i < nthreads; i++) {
+		w[i].b = &b;
+		pthread_create(&w[i].tid, NULL, worker, &w[i]);
+	}
+
+	usleep(duration_ms * 1000);
+	b.stop = 1;
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(w[i].tid, NULL);
+	elapsed = bench_now() - start;
+
+	for (i = 0; i < nthreads; i++) {
+		sum += w[i].ops;
+		sumsq += (double)w[i].ops * w[i].ops;
+		if (w[i].ops < min)
+			min = w[i].ops;
+		if (w[i].ops > max)
+			max = w[i].ops;
+	}
+
+	printf("%-8s %10.0f ops/s  fairness %.3f  min %zu  max %zu\n", name,
+	       sum * 1e9 / elapsed, sumsq ? sum * sum / (nthreads * sumsq) : 0,
+	       min, max);
+
+	sem_destroy(b.lock);
+	free(w);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int nthreads = NTHREADS;
+	unsigned int duration_ms = DURATION_MS;
+
+	if (argc > 1)
+		nthreads = get_argv(argv[1]);
+	if (argc > 2)
+		duration_ms = get_argv(argv[2]);
+
+	run("fifo", SEM_POLICY_FIFO, nthreads, duration_ms);
+	run("barging", SEM_POLICY_BARGING, nthreads, duration_ms);
+
+	return 0;
+}
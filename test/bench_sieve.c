@@ -0,0 +1,200 @@
+/*
+ * Sieve pipeline placement benchmark
+ *
+ * Runs a fixed sieve pipeline (a source, one filter per small prime and a
+ * sink, connected by semaphore-synchronized channels) and reports the average
+ * latency of a hop, i.e. of handing a number from one stage to the next. The
+ * pipeline runs on kernel threads left where the system puts them, then
+ * placed with topo_place_stages(), then on uthreads with and without
+ * wake-affine semaphores.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sem.h>
+#include <topo.h>
+#include <uthread.h>
+
+#include "bench.h"
+
+#define NUMBERS		50000
+#define FILTERS		8
+
+static const unsigned int primes[FILTERS] = { 2, 3, 5, 7, 11, 13, 17, 19 };
+
+struct channel {
+	int value;
+	sem_t produce;
+	sem_t consume;
+};
+
+/* stage i reads channel i - 1 and writes channel i */
+static struct channel channels[FILTERS + 1];
+static unsigned long hops[FILTERS + 2];
+static sem_t start;
+
+static void send(struct channel *c, int value)
+{
+	c->value = value;
+	sem_up(c->consume);
+	sem_down(c->produce);
+}
+
+static int receive(struct channel *c)
+{
+	int value;
+
+	sem_down(c->consume);
+	value = c->value;
+	sem_up(c->produce);
+
+	return value;
+}
+
+static void *source(void *arg)
+{
+	int i;
+
+	(void)arg;
+	sem_down(start);
+
+	for (i = 2; i < NUMBERS + 2; i++)
+		send(&channels[0], i);
+	send(&channels[0], -1);
+	hops[0] = NUMBERS + 1;
+
+	return NULL;
+}
+
+static void *filter(void *arg)
+{
+	long id = (long)arg;
+	int value;
+
+	sem_down(start);
+
+	do {
+		value = receive(&channels[id - 1]);
+		if (value == -1 || value % primes[id - 1] != 0) {
+			send(&channels[id], value);
+			hops[id]++;
+		}
+	} while (value != -1);
+
+	return NULL;
+}
+
+static void *sink(void *arg)
+{
+	(void)arg;
+	sem_down(start);
+
+	while (receive(&channels[FILTERS]) != -1)
+		;
+
+	return NULL;
+}
+
+static void *(*stages[FILTERS + 2])(void *);
+
+static void setup(int affine)
+{
+	int i;
+
+	stages[0] = source;
+	for (i = 1; i <= FILTERS; i++)
+		stages[i] = filter;
+	stages[FILTERS + 1] = sink;
+
+	for (i = 0; i <= FILTERS; i++) {
+		channels[i].produce = sem_create(0);
+		channels[i].consume = sem_create(0);
+		sem_set_wake_affine(channels[i].produce, affine);
+		sem_set_wake_affine(channels[i].consume, affine);
+	}
+	for (i = 0; i < FILTERS + 2; i++)
+		hops[i] = 0;
+	start = sem_create(0);
+}
+
+/* Print the latency of a hop in the run started at @begin, then clean up */
+static void report(const char *label, uint64_t begin)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i <= FILTERS; i++)
+		total += hops[i];
+
+	printf("%-24s %8lu hops %8.0f ns/hop\n", label, total,
+	       (double)(bench_now() - begin) / total);
+
+	for (i = 0; i <= FILTERS; i++) {
+		sem_destroy(channels[i].produce);
+		sem_destroy(channels[i].consume);
+	}
+	sem_destroy(start);
+}
+
+static void run_pthreads(int placed)
+{
+	pthread_t tid[FILTERS + 2];
+	uint64_t begin;
+	long i;
+
+	setup(0);
+	for (i = 0; i < FILTERS + 2; i++)
+		pthread_create(&tid[i], NULL, stages[i], (void*)i);
+
+	if (placed && topo_place_stages(tid, FILTERS + 2) == -1)
+		fprintf(stderr, "could not place the stages\n");
+
+	begin = bench_now();
+	for (i = 0; i < FILTERS + 2; i++)
+		sem_up(start);
+	for (i = 0; i < FILTERS + 2; i++)
+		pthread_join(tid[i], NULL);
+
+	report(placed ? "pthreads, placed" : "pthreads", begin);
+}
+
+static void run_uthreads(int affine)
+{
+	uthread_t tid[FILTERS + 2];
+	uint64_t begin;
+	long i;
+
+	setup(affine);
+	for (i = 0; i < FILTERS + 2; i++)
+		tid[i] = uthread_create(stages[i], (void*)i);
+
+	begin = bench_now();
+	for (i = 0; i < FILTERS + 2; i++)
+		sem_up(start);
+	for (i = 0; i < FILTERS + 2; i++)
+		uthread_join(tid[i], NULL);
+
+	report(affine ? "uthreads, wake-affine" : "uthreads", begin);
+}
+
+int main(void)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int cpus[64];
+	int n;
+
+	n = topo_cache_cpus(0, 0, cpus, 64);
+	printf("%ld cpus, %d sharing the last-level cache of cpu 0\n", ncpus, n);
+
+	run_pthreads(0);
+	run_pthreads(1);
+
+	uthread_init(ncpus);
+	run_uthreads(0);
+	run_uthreads(1);
+
+	return 0;
+}
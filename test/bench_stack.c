@@ -0,0 +1,127 @@
+/*
+ * Thread stack pool benchmark
+ *
+ * Creates and joins many short-lived threads, by waves, each using a few
+ * pages of its stack. Compares the creation/teardown rate and the resident
+ * memory left afterwards for kernel threads with stacks managed by the C
+ * library and with pooled stacks, at the default size and at 64 KiB, and for
+ * uthreads (whose 64 KiB stacks are always pooled).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stack.h>
+#include <uthread.h>
+
+#include "bench.h"
+
+#define THREADS		100000
+#define WAVE		100
+#define TOUCHED		(16 * 1024)
+
+enum mode {
+	MODE_LIBC,
+	MODE_POOLED,
+	MODE_UTHREAD,
+};
+
+static const char *labels[] = {
+	"pthread, libc",
+	"pthread, pooled",
+	"uthread, pooled",
+};
+
+/* Resident memory of the process, in KiB */
+static long resident(void)
+{
+	long size, rss = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	if (f != NULL) {
+		if (fscanf(f, "%ld %ld", &size, &rss) != 2)
+			rss = 0;
+		fclose(f);
+	}
+
+	return rss * 4;
+}
+
+static void *worker(void *arg)
+{
+	volatile char buf[TOUCHED];
+
+	memset((char*)buf, 0, sizeof(buf));
+
+	return arg;
+}
+
+static void run(enum mode mode, size_t size)
+{
+	pthread_attr_t attr[WAVE];
+	pthread_t tid[WAVE];
+	uthread_t ut[WAVE];
+	uint64_t start, elapsed;
+	int i, j;
+
+	start = bench_now();
+
+	for (i = 0; i < THREADS; i += WAVE) {
+		for (j = 0; j < WAVE; j++) {
+			switch (mode) {
+			case MODE_LIBC:
+				pthread_attr_init(&attr[j]);
+				pthread_attr_setstacksize(&attr[j], size);
+				pthread_create(&tid[j], &attr[j], worker, NULL);
+				break;
+			case MODE_POOLED:
+				stack_attr_init(&attr[j], size);
+				pthread_create(&tid[j], &attr[j], worker, NULL);
+				break;
+			case MODE_UTHREAD:
+				ut[j] = uthread_create(worker, NULL);
+				break;
+			}
+		}
+
+		for (j = 0; j < WAVE; j++) {
+			switch (mode) {
+			case MODE_LIBC:
+				pthread_join(tid[j], NULL);
+				pthread_attr_destroy(&attr[j]);
+				break;
+			case MODE_POOLED:
+				pthread_join(tid[j], NULL);
+				stack_attr_destroy(&attr[j]);
+				break;
+			case MODE_UTHREAD:
+				uthread_join(ut[j], NULL);
+				break;
+			}
+		}
+	}
+
+	elapsed = bench_now() - start;
+
+	printf("%-16s %5zu KiB %8.0f threads/s %6.2f us/thread %6ld KiB rss\n",
+	       labels[mode], size / 1024, THREADS * 1e9 / elapsed,
+	       (double)elapsed / THREADS / 1000, resident());
+}
+
+int main(void)
+{
+	printf("%d threads, by waves of %d\n", THREADS, WAVE);
+
+	/* the default stack size of glibc */
+	run(MODE_LIBC, 8 * 1024 * 1024);
+	run(MODE_POOLED, 8 * 1024 * 1024);
+	stack_pool_trim();
+
+	run(MODE_LIBC, 64 * 1024);
+	run(MODE_POOLED, 64 * 1024);
+	run(MODE_UTHREAD, 64 * 1024);
+
+	return 0;
+}
@@ -0,0 +1,346 @@
+/*
+ * Microbenchmark suite
+ *
+ * Measures the basic operations of semaphores, TPS and queues, and prints the
+ * distribution of the samples of each benchmark (median and percentiles) as
+ * JSON, so that runs before and after a change can be compared. Operations
+ * too short to be timed one by one are timed by batches, each sample being
+ * the average of a batch.
+ *
+ * Usage: bench_suite.x [filter], only running the benchmarks whose name
+ * contains filter.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <queue.h>
+#include <sem.h>
+#include <tps.h>
+
+#include "bench.h"
+
+#define SAMPLES		200
+#define BATCH		1000
+#define PINGS		20000
+#define ITEMS		100000
+#define CAPACITY	64
+#define RUNS		20
+#define CLONES		500
+#define QUEUE_DEPTH	16
+#define QUEUE_LENGTH	1000
+
+static const char *filter;
+static double samples[PINGS];
+
+static int selected(const char *name)
+{
+	return filter == NULL || strstr(name, filter) != NULL;
+}
+
+/* Semaphores */
+
+static void sem_uncontended(void)
+{
+	sem_t sem = sem_create(1);
+	uint64_t start;
+	int s, i;
+
+	for (s = 0; s < SAMPLES; s++) {
+		start = bench_now();
+		for (i = 0; i < BATCH; i++) {
+			sem_down(sem);
+			sem_up(sem);
+		}
+		samples[s] = (double)(bench_now() - start) / BATCH;
+	}
+
+	bench_json("sem/uncontended", "ns/down+up", samples, SAMPLES);
+	sem_destroy(sem);
+}
+
+static sem_t ping, pong;
+
+static void *ponger(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < PINGS; i++) {
+		sem_down(ping);
+		sem_up(pong);
+	}
+
+	return NULL;
+}
+
+static void sem_pingpong(void)
+{
+	pthread_t tid;
+	uint64_t start;
+	int i;
+
+	ping = sem_create(0);
+	pong = sem_create(0);
+	pthread_create(&tid, NULL, ponger, NULL);
+
+	for (i = 0; i < PINGS; i++) {
+		start = bench_now();
+		sem_up(ping);
+		sem_down(pong);
+		samples[i] = bench_now() - start;
+	}
+
+	pthread_join(tid, NULL);
+	bench_json("sem/pingpong", "ns/round trip", samples, PINGS);
+	sem_destroy(ping);
+	sem_destroy(pong);
+}
+
+/* Bounded buffer shared by producers and consumers */
+static struct {
+	sem_t empty, full, lock;
+	size_t buffer[CAPACITY];
+	size_t head, tail;
+	size_t count; /* items per thread */
+} bb;
+
+static void *producer(void *arg)
+{
+	size_t i;
+
+	(void)arg;
+
+	for (i = 0; i < bb.count; i++) {
+		sem_down(bb.empty);
+		sem_down(bb.lock);
+		bb.buffer[bb.tail++ % CAPACITY] = i;
+		sem_up(bb.lock);
+		sem_up(bb.full);
+	}
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	size_t i;
+
+	(void)arg;
+
+	for (i = 0; i < bb.count; i++) {
+		sem_down(bb.full);
+		sem_down(bb.lock);
+		bb.head++;
+		sem_up(bb.lock);
+		sem_up(bb.empty);
+	}
+
+	return NULL;
+}
+
+static void sem_mpmc(int threads)
+{
+	pthread_t tid[2 * 8];
+	char name[32];
+	uint64_t start;
+	int r, i;
+
+	for (r = 0; r < RUNS; r++) {
+		bb.empty = sem_create(CAPACITY);
+		bb.full = sem_create(0);
+		bb.lock = sem_create(1);
+		bb.head = bb.tail = 0;
+		bb.count = ITEMS / threads;
+
+		start = bench_now();
+		for (i = 0; i < threads; i++) {
+			pthread_create(&tid[2 * i], NULL, producer, NULL);
+			pthread_create(&tid[2 * i + 1], NULL, consumer, NULL);
+		}
+		for (i = 0; i < 2 * threads; i++)
+			pthread_join(tid[i], NULL);
+		samples[r] = (double)(bench_now() - start) / (bb.count * threads);
+
+		sem_destroy(bb.empty);
+		sem_destroy(bb.full);
+		sem_destroy(bb.lock);
+	}
+
+	snprintf(name, sizeof(name), "sem/mpmc/%dx%d", threads, threads);
+	bench_json(name, "ns/item", samples, RUNS);
+}
+
+/* TPS */
+
+static void tps_access(const char *op, size_t size)
+{
+	static char buffer[TPS_SIZE];
+	char name[32];
+	uint64_t start;
+	int s, i;
+
+	for (s = 0; s < SAMPLES; s++) {
+		start = bench_now();
+		for (i = 0; i < BATCH / 10; i++) {
+			if (op[0] == 'r')
+				tps_read(0, size, buffer);
+			else
+				tps_write(0, size, buffer);
+		}
+		samples[s] = (double)(bench_now() - start) / (BATCH / 10);
+	}
+
+	snprintf(name, sizeof(name), "tps/%s/%zu", op, size);
+	bench_json(name, "ns/op", samples, SAMPLES);
+}
+
+static pthread_t owner;
+static double clones[CLONES], cows[CLONES];
+
+static void *cloner(void *arg)
+{
+	size_t i = (size_t)arg;
+	uint64_t start;
+
+	start = bench_now();
+	tps_clone(owner);
+	clones[i] = bench_now() - start;
+
+	/* first write to the shared page */
+	start = bench_now();
+	tps_write(0, 1, "x");
+	cows[i] = bench_now() - start;
+
+	tps_destroy();
+
+	return NULL;
+}
+
+static void tps_clone_cow(void)
+{
+	pthread_t tid;
+	size_t i;
+
+	owner = pthread_self();
+
+	for (i = 0; i < CLONES; i++) {
+		pthread_create(&tid, NULL, cloner, (void*)i);
+		pthread_join(tid, NULL);
+	}
+
+	if (selected("tps/clone"))
+		bench_json("tps/clone", "ns/op", clones, CLONES);
+	if (selected("tps/cow"))
+		bench_json("tps/cow", "ns/op", cows, CLONES);
+}
+
+/* Queues */
+
+static int count(void *data, void *arg)
+{
+	(void)data;
+	(*(size_t*)arg)++;
+	return 0;
+}
+
+static void queue_ops(void)
+{
+	static queue_handle_t handles[QUEUE_LENGTH];
+	queue_t queue = queue_create();
+	size_t i, n = 0;
+	uint64_t start;
+	void *data;
+	int s;
+
+	if (selected("queue/fifo")) {
+		for (i = 0; i < QUEUE_DEPTH; i++)
+			queue_enqueue(queue, (void*)i);
+		for (s = 0; s < SAMPLES; s++) {
+			start = bench_now();
+			for (i = 0; i < BATCH; i++) {
+				queue_dequeue(queue, &data);
+				queue_enqueue(queue, data);
+			}
+			samples[s] = (double)(bench_now() - start) / BATCH;
+		}
+		bench_json("queue/fifo", "ns/dequeue+enqueue", samples, SAMPLES);
+		while (queue_dequeue(queue, &data) == 0)
+			;
+	}
+
+	for (i = 0; i < QUEUE_LENGTH; i++)
+		queue_enqueue_handle(queue, (void*)i, &handles[i]);
+
+	if (selected("queue/iterate")) {
+		for (s = 0; s < SAMPLES; s++) {
+			start = bench_now();
+			queue_iterate(queue, count, &n, NULL);
+			samples[s] = (double)(bench_now() - start) / QUEUE_LENGTH;
+		}
+		bench_json("queue/iterate", "ns/item", samples, SAMPLES);
+	}
+
+	if (selected("queue/delete")) {
+		for (s = 0; s < SAMPLES; s++) {
+			start = bench_now();
+			for (i = 0; i < QUEUE_LENGTH; i++) {
+				/* from the middle, then back at the end */
+				queue_delete_handle(queue, handles[i]);
+				queue_enqueue_handle(queue, (void*)i, &handles[i]);
+			}
+			samples[s] = (double)(bench_now() - start) / QUEUE_LENGTH;
+		}
+		bench_json("queue/delete", "ns/delete+enqueue", samples,
+			   SAMPLES);
+	}
+
+	while (queue_dequeue(queue, &data) == 0)
+		;
+	queue_destroy(queue);
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t sizes[] = { 8, 64, 512, TPS_SIZE };
+	size_t i;
+
+	if (argc > 1)
+		filter = argv[1];
+
+	bench_json_begin();
+
+	if (selected("sem/uncontended"))
+		sem_uncontended();
+	if (selected("sem/pingpong"))
+		sem_pingpong();
+	if (selected("sem/mpmc/1x1"))
+		sem_mpmc(1);
+	if (selected("sem/mpmc/4x4"))
+		sem_mpmc(4);
+
+	tps_init(0);
+	tps_create();
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		char name[32];
+
+		snprintf(name, sizeof(name), "tps/read/%zu", sizes[i]);
+		if (selected(name))
+			tps_access("read", sizes[i]);
+		snprintf(name, sizeof(name), "tps/write/%zu", sizes[i]);
+		if (selected(name))
+			tps_access("write", sizes[i]);
+	}
+	if (selected("tps/clone") || selected("tps/cow"))
+		tps_clone_cow();
+	tps_destroy();
+
+	queue_ops();
+
+	bench_json_end();
+
+	return 0;
+}
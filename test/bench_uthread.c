@@ -0,0 +1,121 @@
+/*
+ * User-level threads benchmark
+ *
+ * Measures, on a single worker, the cost of a context switch between two
+ * uthreads yielding to each other, then compares a semaphore ping-pong (each
+ * side blocking until the other one releases it) between two uthreads and
+ * between two kernel threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sem.h>
+#include <uthread.h>
+
+#include "bench.h"
+
+#define YIELDS		1000000
+#define ROUNDS		200000
+
+static sem_t ping, pong;
+
+static void *yielder(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < YIELDS; i++)
+		uthread_yield();
+
+	return NULL;
+}
+
+static void *pinger(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < ROUNDS; i++) {
+		sem_up(ping);
+		sem_down(pong);
+	}
+
+	return NULL;
+}
+
+static void *ponger(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < ROUNDS; i++) {
+		sem_down(ping);
+		sem_up(pong);
+	}
+
+	return NULL;
+}
+
+static double bench_yield(void)
+{
+	uthread_t a, b;
+	uint64_t start = bench_now();
+
+	a = uthread_create(yielder, NULL);
+	b = uthread_create(yielder, NULL);
+	uthread_join(a, NULL);
+	uthread_join(b, NULL);
+
+	/* each yield switches out to the worker and back in */
+	return (double)(bench_now() - start) / (2 * YIELDS);
+}
+
+static double bench_pingpong_uthreads(void)
+{
+	uthread_t a, b;
+	uint64_t start = bench_now();
+
+	a = uthread_create(pinger, NULL);
+	b = uthread_create(ponger, NULL);
+	uthread_join(a, NULL);
+	uthread_join(b, NULL);
+
+	return (double)(bench_now() - start) / ROUNDS;
+}
+
+static double bench_pingpong_pthreads(void)
+{
+	pthread_t a, b;
+	uint64_t start = bench_now();
+
+	pthread_create(&a, NULL, pinger, NULL);
+	pthread_create(&b, NULL, ponger, NULL);
+	pthread_join(a, NULL);
+	pthread_join(b, NULL);
+
+	return (double)(bench_now() - start) / ROUNDS;
+}
+
+int main(void)
+{
+	uthread_init(1);
+
+	ping = sem_create(0);
+	pong = sem_create(0);
+
+	printf("uthread yield:      %8.1f ns/switch\n", bench_yield());
+	printf("uthread ping-pong:  %8.1f ns/round trip\n",
+	       bench_pingpong_uthreads());
+	printf("pthread ping-pong:  %8.1f ns/round trip\n",
+	       bench_pingpong_pthreads());
+
+	sem_destroy(ping);
+	sem_destroy(pong);
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Channel test
+ *
+ * Producers send increasing values to a small channel in batches of random
+ * sizes, while consumers receive them in batches of other random sizes until
+ * the channel gets closed. With a single producer and a single consumer the
+ * values must come out in order; with several of each, every value must be
+ * received exactly once.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chan.h>
+
+#define CAPACITY	16
+#define BATCH		24
+#define MAXCOUNT	100000
+
+struct test {
+	chan_t chan;
+	size_t maxcount;
+	unsigned long sum;
+	size_t received;
+	int ordered;
+	unsigned int seed;
+};
+
+static void *producer(void *arg)
+{
+	struct test *t = (struct test*)arg;
+	void *items[BATCH];
+	unsigned int seed = __atomic_add_fetch(&t->seed, 1, __ATOMIC_RELAXED);
+	size_t count = 0;
+
+	while (count < t->maxcount) {
+		size_t i, n = rand_r(&seed) % BATCH + 1;
+
+		if (n > t->maxcount - count)
+			n = t->maxcount - count;
+		for (i = 0; i < n; i++)
+			items[i] = (void*)(uintptr_t)++count;
+		assert(chan_send_batch(t->chan, items, n) == (int)n);
+	}
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	struct test *t = (struct test*)arg;
+	void *items[BATCH];
+	unsigned int seed = __atomic_add_fetch(&t->seed, 1, __ATOMIC_RELAXED);
+	uintptr_t last = 0;
+	int i, n;
+
+	while ((n = chan_recv_batch(t->chan, items,
+				    rand_r(&seed) % BATCH + 1)) > 0) {
+		for (i = 0; i < n; i++) {
+			uintptr_t value = (uintptr_t)items[i];
+
+			if (t->ordered)
+				assert(value == last + 1);
+			last = value;
+			__atomic_add_fetch(&t->sum, value, __ATOMIC_RELAXED);
+		}
+		__atomic_add_fetch(&t->received, n, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+static void run(chan_mode_t mode, int nproducers, int nconsumers,
+		size_t maxcount)
+{
+	struct test t;
+	pthread_t prod[nproducers], cons[nconsumers];
+	int i;
+
+	t.chan = chan_create(CAPACITY, mode);
+	t.maxcount = maxcount;
+	t.sum = 0;
+	t.received = 0;
+	t.ordered = nproducers == 1 && nconsumers == 1;
+	t.seed = 0;
+
+	for (i = 0; i < nconsumers; i++)
+		pthread_create(&cons[i], NULL, consumer, &t);
+	for (i = 0; i < nproducers; i++)
+		pthread_create(&prod[i], NULL, producer, &t);
+
+	for (i = 0; i < nproducers; i++)
+		pthread_join(prod[i], NULL);
+	chan_close(t.chan);
+	for (i = 0; i < nconsumers; i++)
+		pthread_join(cons[i], NULL);
+
+	printf("%s %dx%d: received %zu items\n", mode == CHAN_SPSC ? "spsc" : "mpmc",
+	       nproducers, nconsumers, t.received);
+	assert(t.received == nproducers * maxcount);
+	assert(t.sum == nproducers * maxcount * (maxcount + 1) / 2);
+	assert(chan_destroy(t.chan) == 0);
+}
+
+static void test_errors(void)
+{
+	chan_t chan = chan_create(2, CHAN_SPSC);
+	void *item;
+
+	assert(chan_create(0, CHAN_SPSC) == NULL);
+	assert(chan_create(1, 42) == NULL);
+	assert(chan_send(NULL, NULL) == -1);
+	assert(chan_recv(chan, NULL) == -1);
+	assert(chan_recv_batch(chan, &item, 0) == -1);
+
+	/* try variants never block */
+	assert(chan_tryrecv(chan, &item) == -1);
+	assert(chan_trysend(chan, (void*)1) == 0);
+	assert(chan_trysend(chan, (void*)2) == 0);
+	assert(chan_trysend(chan, (void*)3) == -1);
+	assert(chan_tryrecv(chan, &item) == 0 && item == (void*)1);
+
+	/* closed channels keep delivering what they hold */
+	assert(chan_close(chan) == 0);
+	assert(chan_send(chan, (void*)4) == -1);
+	assert(chan_recv(chan, &item) == 0 && item == (void*)2);
+	assert(chan_recv(chan, &item) == -1);
+
+	assert(chan_destroy(chan) == 0);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxcount = MAXCOUNT;
+
+	if (argc > 1)
+		maxcount = get_argv(argv[1]);
+
+	test_errors();
+	run(CHAN_SPSC, 1, 1, maxcount);
+	run(CHAN_MPMC, 1, 1, maxcount);
+	run(CHAN_MPMC, 3, 2, maxcount);
+
+	return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Condition variable test
+ *
+ * Producers and consumers, threads and uthreads, share a bounded buffer
+ * guarded by a lock and two condition variables: every item must be consumed
+ * exactly once. Then many threads wait on a flag: a broadcast made while
+ * holding the lock must move all of them to the waiting list of the lock
+ * without waking any, and they must all get through once it is released.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cond.h>
+#include <sem.h>
+#include <uthread.h>
+
+#define CAPACITY 8
+#define NPRODUCERS 4
+#define NCONSUMERS 4
+#define ITEMS 10000 /* per producer */
+#define NWAITERS 200
+
+static sem_t lock;
+static cond_t not_full, not_empty;
+static size_t buffer[CAPACITY], head, tail;
+static size_t consumed, sum;
+
+static void *producer(void *arg)
+{
+	size_t i;
+
+	(void)arg;
+
+	for (i = 1; i <= ITEMS; i++) {
+		sem_down(lock);
+		while (tail - head == CAPACITY)
+			assert(cond_wait(not_full, lock) == 0);
+		buffer[tail++ % CAPACITY] = i;
+		cond_signal(not_empty);
+		sem_up(lock);
+	}
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	(void)arg;
+
+	while (1) {
+		sem_down(lock);
+		while (tail == head && consumed < NPRODUCERS * ITEMS)
+			assert(cond_wait(not_empty, lock) == 0);
+		if (consumed == NPRODUCERS * ITEMS) {
+			sem_up(lock);
+			break;
+		}
+		sum += buffer[head++ % CAPACITY];
+		if (++consumed == NPRODUCERS * ITEMS)
+			cond_broadcast(not_empty); /* let the other consumers out */
+		cond_signal(not_full);
+		sem_up(lock);
+	}
+
+	return NULL;
+}
+
+static cond_t go;
+static int flag, waiting, passed;
+
+static void *waiter(void *arg)
+{
+	(void)arg;
+
+	sem_down(lock);
+	waiting++;
+	while (!flag)
+		assert(cond_wait(go, lock) == 0);
+	passed++;
+	sem_up(lock);
+
+	return NULL;
+}
+
+static void buffer_test(void)
+{
+	pthread_t tid[NPRODUCERS];
+	uthread_t ut[NCONSUMERS];
+	int i;
+
+	/* producers are threads, consumers uthreads */
+	for (i = 0; i < NPRODUCERS; i++)
+		pthread_create(&tid[i], NULL, producer, NULL);
+	for (i = 0; i < NCONSUMERS; i++)
+		ut[i] = uthread_create(consumer, NULL);
+
+	for (i = 0; i < NPRODUCERS; i++)
+		pthread_join(tid[i], NULL);
+	for (i = 0; i < NCONSUMERS; i++)
+		assert(uthread_join(ut[i], NULL) == 0);
+
+	assert(consumed == NPRODUCERS * ITEMS);
+	assert(sum == (size_t)NPRODUCERS * ITEMS * (ITEMS + 1) / 2);
+}
+
+static void broadcast_test(void)
+{
+	static pthread_t tid[NWAITERS];
+	int i, value;
+
+	for (i = 0; i < NWAITERS; i++)
+		pthread_create(&tid[i], NULL, waiter, NULL);
+
+	sem_down(lock);
+	while (waiting < NWAITERS) {
+		sem_up(lock);
+		sched_yield();
+		sem_down(lock);
+	}
+
+	/* everyone is waiting on the condition, not on the lock */
+	assert(sem_getvalue(lock, &value) == 0 && value == 0);
+	assert(cond_destroy(go) == -1);
+
+	flag = 1;
+	assert(cond_broadcast(go) == 0);
+
+	/* now everyone is waiting on the lock */
+	assert(sem_getvalue(lock, &value) == 0 && value == -NWAITERS);
+	assert(passed == 0);
+	sem_up(lock);
+
+	for (i = 0; i < NWAITERS; i++)
+		pthread_join(tid[i], NULL);
+	assert(passed == NWAITERS);
+}
+
+int main(void)
+{
+	sem_t shared;
+
+	assert(cond_wait(NULL, NULL) == -1);
+	assert(cond_signal(NULL) == -1);
+	assert(cond_broadcast(NULL) == -1);
+	assert(cond_destroy(NULL) == -1);
+
+	lock = sem_create(1);
+	not_full = cond_create();
+	not_empty = cond_create();
+	go = cond_create();
+	assert(cond_wait(go, NULL) == -1);
+
+	/* nobody to signal */
+	assert(cond_signal(go) == 0);
+	assert(cond_broadcast(go) == 0);
+
+	shared = sem_create_shared("/uthread_cond_test", 1);
+	if (shared != NULL) {
+		sem_down(shared);
+		assert(cond_wait(go, shared) == -1);
+		sem_up(shared);
+		sem_destroy(shared);
+		sem_unlink("/uthread_cond_test");
+	}
+
+	assert(uthread_init(2) == 0);
+	buffer_test();
+	broadcast_test();
+
+	assert(cond_destroy(not_full) == 0);
+	assert(cond_destroy(not_empty) == 0);
+	assert(cond_destroy(go) == 0);
+	sem_destroy(lock);
+
+	printf("%d items, %d waiters broadcast to\n", NPRODUCERS * ITEMS,
+	       NWAITERS);
+
+	return 0;
+}
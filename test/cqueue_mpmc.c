@@ -0,0 +1,142 @@
+/*
+ * Concurrent queue test
+ *
+ * Several producers and consumers share a bounded and then an unbounded
+ * concurrent queue, without any other synchronization. Every item must be
+ * dequeued exactly once, and each consumer must see the items of any given
+ * producer in the order they were enqueued.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cqueue.h>
+
+#define NPRODUCERS 4
+#define NCONSUMERS 4
+#define NITEMS 200000
+
+static cqueue_t queue;
+static size_t consumed;
+static uint64_t sums[NCONSUMERS];
+
+/* items encode their producer and sequence number, and are never NULL */
+#define ITEM(p, i) ((void*)(((uintptr_t)(p) + 1) << 32 | ((uintptr_t)(i) + 1)))
+#define PRODUCER(item) ((int)((uintptr_t)(item) >> 32) - 1)
+#define SEQ(item) ((size_t)((uintptr_t)(item) & 0xffffffff) - 1)
+
+static void *producer(void *arg)
+{
+	int p = (int)(long)arg;
+	size_t i;
+
+	for (i = 0; i < NITEMS; i++)
+		while (cqueue_enqueue(queue, ITEM(p, i)) == -1)
+			sched_yield();
+
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	int c = (int)(long)arg;
+	long last[NPRODUCERS];
+	void *item;
+	int p;
+
+	for (p = 0; p < NPRODUCERS; p++)
+		last[p] = -1;
+
+	while (__atomic_load_n(&consumed, __ATOMIC_RELAXED) <
+	       (size_t)NPRODUCERS * NITEMS) {
+		if (cqueue_dequeue(queue, &item) == -1) {
+			sched_yield();
+			continue;
+		}
+
+		p = PRODUCER(item);
+		assert(p >= 0 && p < NPRODUCERS);
+		assert((long)SEQ(item) > last[p]);
+		last[p] = SEQ(item);
+		sums[c] += SEQ(item);
+		__atomic_fetch_add(&consumed, 1, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+static void run(size_t capacity)
+{
+	pthread_t tid[NPRODUCERS + NCONSUMERS];
+	uint64_t sum = 0;
+	void *item;
+	int i;
+
+	queue = cqueue_create(capacity);
+	consumed = 0;
+
+	for (i = 0; i < NCONSUMERS; i++) {
+		sums[i] = 0;
+		pthread_create(&tid[i], NULL, consumer, (void*)(long)i);
+	}
+	for (i = 0; i < NPRODUCERS; i++)
+		pthread_create(&tid[NCONSUMERS + i], NULL, producer, (void*)(long)i);
+
+	for (i = 0; i < NPRODUCERS + NCONSUMERS; i++)
+		pthread_join(tid[i], NULL);
+
+	for (i = 0; i < NCONSUMERS; i++)
+		sum += sums[i];
+	assert(consumed == (size_t)NPRODUCERS * NITEMS);
+	assert(sum == (uint64_t)NPRODUCERS * NITEMS * (NITEMS - 1) / 2);
+
+	assert(cqueue_dequeue(queue, &item) == -1);
+	assert(cqueue_destroy(queue) == 0);
+
+	printf("capacity %zu: %zu items\n", capacity, consumed);
+}
+
+int main(void)
+{
+	cqueue_t q;
+	void *item;
+	int i;
+
+	assert(cqueue_enqueue(NULL, ITEM(0, 0)) == -1);
+	assert(cqueue_destroy(NULL) == -1);
+
+	/* capacity is rounded up to a power of two */
+	q = cqueue_create(5);
+	for (i = 0; i < 8; i++)
+		assert(cqueue_enqueue(q, ITEM(0, i)) == 0);
+	assert(cqueue_enqueue(q, ITEM(0, 8)) == -1);
+	assert(cqueue_destroy(q) == -1);
+	for (i = 0; i < 8; i++) {
+		assert(cqueue_dequeue(q, &item) == 0);
+		assert(SEQ(item) == (size_t)i);
+	}
+	assert(cqueue_dequeue(q, &item) == -1);
+	assert(cqueue_destroy(q) == 0);
+
+	/* unbounded queues span several segments */
+	q = cqueue_create(0);
+	assert(cqueue_enqueue(q, NULL) == -1);
+	for (i = 0; i < 1000; i++)
+		assert(cqueue_enqueue(q, ITEM(0, i)) == 0);
+	assert(cqueue_destroy(q) == -1);
+	for (i = 0; i < 1000; i++) {
+		assert(cqueue_dequeue(q, &item) == 0);
+		assert(SEQ(item) == (size_t)i);
+	}
+	assert(cqueue_dequeue(q, &item) == -1);
+	assert(cqueue_destroy(q) == 0);
+
+	run(64);
+	run(0);
+
+	return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Critical section profiler test
+ *
+ * Several threads contend on a semaphore. When the library is built with the
+ * profiler (`make CSPROF=1`), the call sites of sem.c must account for every
+ * entry into the critical section, and the most contended ones are printed.
+ * Otherwise, the profiler functions must consistently fail.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <csprof.h>
+#include <sem.h>
+
+#define NTHREADS 4
+#define LOOPS 1000
+#define TOP 64
+
+static sem_t sem;
+
+static void *worker(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < LOOPS; i++) {
+		sem_down(sem);
+		sched_yield();
+		sem_up(sem);
+	}
+
+	return NULL;
+}
+
+/* Total acquisitions of the call sites of @file */
+static uint64_t acquisitions(const char *file)
+{
+	static struct csprof_site sites[TOP];
+	uint64_t total = 0, wait = UINT64_MAX, hist;
+	int i, b, n;
+
+	n = csprof_top(sites, TOP);
+	assert(n >= 0);
+
+	for (i = 0; i < n; i++) {
+		/* by decreasing wait time */
+		assert(sites[i].wait_total_ns <= wait);
+		wait = sites[i].wait_total_ns;
+
+		hist = 0;
+		for (b = 0; b < CSPROF_BUCKETS; b++)
+			hist += sites[i].hold_hist[b];
+		/* holds are split when blocking within the critical section */
+		assert(hist >= sites[i].acquisitions);
+		assert(sites[i].wait_max_ns <= sites[i].wait_total_ns);
+		assert(sites[i].caller != NULL);
+
+		if (strstr(sites[i].file, file) != NULL)
+			total += sites[i].acquisitions;
+	}
+
+	return total;
+}
+
+int main(void)
+{
+	struct csprof_site site;
+	pthread_t tid[NTHREADS];
+	int i;
+
+	sem = sem_create(1);
+
+	if (csprof_reset() == -1) {
+		/* library built without the profiler */
+		assert(csprof_top(&site, 1) == -1);
+		assert(csprof_report(stdout, 0) == -1);
+		printf("profiler disabled\n");
+		sem_destroy(sem);
+		return 0;
+	}
+
+	assert(csprof_top(NULL, 1) == -1);
+	assert(csprof_top(&site, 0) == -1);
+	assert(csprof_report(NULL, 0) == -1);
+	assert(acquisitions("sem.c") == 0);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_create(&tid[i], NULL, worker, NULL);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	/* one entry per down and per up */
+	assert(acquisitions("sem.c") == 2 * NTHREADS * LOOPS);
+
+	assert(csprof_report(stdout, 3) == 0);
+
+	assert(csprof_reset() == 0);
+	assert(acquisitions("sem.c") == 0);
+
+	sem_destroy(sem);
+
+	return 0;
+}
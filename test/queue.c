@@ -0,0 +1,208 @@
+/*
+ * Queue test
+ *
+ * Exercise the queue across growth of its storage and reuse of its nodes,
+ * checking FIFO order, deletion by value and by handle, and iteration against
+ * a plain array model, also when deleting at random from a queue of constant
+ * length. Finally, iterate while enqueueing and deleting items.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <queue.h>
+
+#define MAXITEMS 100
+
+static size_t model[MAXITEMS];
+static queue_handle_t handles[MAXITEMS];
+static size_t head, tail;
+
+static int check(void *data, void *arg)
+{
+	size_t *i = (size_t*)arg;
+
+	assert((size_t)data == model[head + *i]);
+	(*i)++;
+
+	return 0;
+}
+
+static int find(void *data, void *arg)
+{
+	return (size_t)data == (size_t)arg;
+}
+
+static void verify(queue_t queue)
+{
+	size_t i = 0;
+	void *data = NULL;
+
+	assert(queue_length(queue) == (int)(tail - head));
+	assert(queue_iterate(queue, check, &i, NULL) == 0);
+	assert(i == tail - head);
+
+	if (tail > head) {
+		assert(queue_iterate(queue, find, (void*)model[tail - 1],
+				     &data) == 0);
+		assert((size_t)data == model[tail - 1]);
+	}
+}
+
+static void delete(queue_t queue, size_t i, int byHandle)
+{
+	queue_handle_t handle = handles[head + i];
+
+	if (byHandle)
+		assert(queue_delete_handle(queue, handle) == 0);
+	else
+		assert(queue_delete(queue, (void*)model[head + i]) == 0);
+
+	/* the handle is stale from now on */
+	assert(queue_delete_handle(queue, handle) == -1);
+
+	for (i += head; i + 1 < tail; i++) {
+		model[i] = model[i + 1];
+		handles[i] = handles[i + 1];
+	}
+	tail--;
+}
+
+/* delete items from the middle and enqueue new ones, the length staying put */
+static void churn(void)
+{
+	queue_t queue = queue_create();
+	uint32_t rand = 2463534242u;
+	size_t round, i, next = 1;
+	void *data;
+
+	head = tail = 0;
+	for (i = 0; i < MAXITEMS / 2; i++) {
+		assert(queue_enqueue_handle(queue, (void*)next,
+					    &handles[tail]) == 0);
+		model[tail++] = next++;
+	}
+
+	for (round = 0; round < 10000; round++) {
+		rand ^= rand << 13;
+		rand ^= rand >> 17;
+		rand ^= rand << 5;
+
+		delete(queue, rand % (tail - head), 1);
+		assert(queue_enqueue_handle(queue, (void*)next,
+					    &handles[tail]) == 0);
+		model[tail++] = next++;
+
+		if (round % 100 == 0)
+			verify(queue);
+	}
+	verify(queue);
+
+	while (queue_dequeue(queue, &data) == 0)
+		assert((size_t)data == model[head++]);
+	assert(queue_destroy(queue) == 0);
+}
+
+/* delete the next item, if any, and enqueue a copy of original items */
+static int modify(void *data, void *arg)
+{
+	queue_t queue = (queue_t)arg;
+
+	assert((size_t)data % 2 == 1);
+	queue_delete(queue, (void*)((size_t)data + 1));
+	if ((size_t)data < 100)
+		assert(queue_enqueue(queue, (void*)((size_t)data + 100)) == 0);
+
+	return 0;
+}
+
+static int collect(void *data, void *arg)
+{
+	size_t **p = (size_t**)arg;
+
+	*(*p)++ = (size_t)data;
+
+	return 0;
+}
+
+/* anything but deleting the current item is allowed while iterating */
+static void iterate_modify(void)
+{
+	queue_t queue = queue_create();
+	size_t items[16], *p = items, i;
+	void *data;
+
+	for (i = 1; i <= 16; i++)
+		assert(queue_enqueue(queue, (void*)i) == 0);
+
+	assert(queue_iterate(queue, modify, queue, NULL) == 0);
+
+	assert(queue_length(queue) == 16);
+	assert(queue_iterate(queue, collect, &p, NULL) == 0);
+	for (i = 0; i < 8; i++) {
+		assert(items[i] == 2 * i + 1);
+		assert(items[i + 8] == 2 * i + 101);
+	}
+
+	while (queue_dequeue(queue, &data) == 0)
+		;
+	assert(queue_destroy(queue) == 0);
+}
+
+int main(void)
+{
+	queue_t queue = queue_create();
+	size_t round, i, next = 1;
+	void *data;
+
+	assert(queue_dequeue(queue, &data) == -1);
+	assert(queue_delete(queue, (void*)1) == -1);
+	assert(queue_enqueue(queue, NULL) == -1);
+	assert(queue_length(NULL) == -1);
+	assert(queue_delete_handle(queue, 0) == -1);
+
+	for (round = 0; round < 1000; round++) {
+		/* compact the model, items keep their order */
+		for (i = head; i < tail; i++) {
+			model[i - head] = model[i];
+			handles[i - head] = handles[i];
+		}
+		tail -= head;
+		head = 0;
+
+		/* push a few, pop fewer, to wrap around and grow */
+		for (i = 0; i < round % 7 + 1 && tail < MAXITEMS; i++) {
+			assert(queue_enqueue_handle(queue, (void*)next,
+						    &handles[tail]) == 0);
+			model[tail++] = next++;
+		}
+		verify(queue);
+
+		for (i = 0; i < round % 5 && head < tail; i++) {
+			assert(queue_dequeue(queue, &data) == 0);
+			assert(queue_delete_handle(queue, handles[head]) == -1);
+			assert((size_t)data == model[head++]);
+		}
+		verify(queue);
+
+		/* delete near the front and near the back */
+		if (round % 4 == 0 && tail - head > 2) {
+			delete(queue, 1, 0);
+			delete(queue, tail - head - 2, 1);
+		}
+		verify(queue);
+	}
+
+	while (queue_dequeue(queue, &data) == 0)
+		assert((size_t)data == model[head++]);
+	assert(head == tail);
+	assert(queue_destroy(queue) == 0);
+
+	churn();
+	iterate_modify();
+
+	printf("queue ok\n");
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Reader-writer lock test
+ *
+ * Writers keep two counters equal by incrementing both while holding the lock
+ * for writing, while readers check under the read lock that they are always
+ * seen equal. Writer preference is checked separately: once a writer waits,
+ * new readers must be turned away.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <rwlock.h>
+
+#define NREADERS	4
+#define NWRITERS	2
+#define MAXCOUNT	20000
+
+struct test {
+	rwlock_t lock;
+	volatile size_t a, b;
+	size_t maxcount;
+	size_t reads;
+	volatile int done;
+};
+
+static void *reader(void *arg)
+{
+	struct test *t = (struct test*)arg;
+	size_t reads = 0;
+
+	while (!t->done) {
+		rwlock_rdlock(t->lock);
+		assert(t->a == t->b);
+		rwlock_unlock(t->lock);
+		if (++reads % 64 == 0)
+			sched_yield();
+	}
+
+	__atomic_add_fetch(&t->reads, reads, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+static void *writer(void *arg)
+{
+	struct test *t = (struct test*)arg;
+	size_t i;
+
+	for (i = 0; i < t->maxcount; i++) {
+		rwlock_wrlock(t->lock);
+		t->a++;
+		sched_yield(); /* let readers try to get in */
+		t->b++;
+		rwlock_unlock(t->lock);
+	}
+
+	return NULL;
+}
+
+static void test_stress(size_t maxcount)
+{
+	pthread_t readers[NREADERS], writers[NWRITERS];
+	struct test t;
+	int i;
+
+	t.lock = rwlock_create();
+	t.a = t.b = 0;
+	t.maxcount = maxcount;
+	t.reads = 0;
+	t.done = 0;
+
+	for (i = 0; i < NREADERS; i++)
+		pthread_create(&readers[i], NULL, reader, &t);
+	for (i = 0; i < NWRITERS; i++)
+		pthread_create(&writers[i], NULL, writer, &t);
+
+	for (i = 0; i < NWRITERS; i++)
+		pthread_join(writers[i], NULL);
+	t.done = 1;
+	for (i = 0; i < NREADERS; i++)
+		pthread_join(readers[i], NULL);
+
+	printf("%zu writes, %zu reads\n", t.a, t.reads);
+	assert(t.a == NWRITERS * maxcount && t.b == t.a);
+	assert(rwlock_destroy(t.lock) == 0);
+}
+
+static void *blocked_writer(void *arg)
+{
+	rwlock_t lock = (rwlock_t)arg;
+
+	rwlock_wrlock(lock);
+	rwlock_unlock(lock);
+
+	return NULL;
+}
+
+static void test_preference(void)
+{
+	rwlock_t lock = rwlock_create();
+	pthread_t tid;
+	int i;
+
+	assert(rwlock_rdlock(NULL) == -1);
+	assert(rwlock_unlock(lock) == -1);
+
+	/* readers share, writers exclude */
+	assert(rwlock_rdlock(lock) == 0);
+	assert(rwlock_tryrdlock(lock) == 0);
+	assert(rwlock_trywrlock(lock) == -1);
+	assert(rwlock_unlock(lock) == 0);
+	assert(rwlock_destroy(lock) == -1);
+
+	/* a waiting writer turns new readers away */
+	pthread_create(&tid, NULL, blocked_writer, lock);
+	for (i = 0; i < 1000 && rwlock_tryrdlock(lock) == 0; i++) {
+		rwlock_unlock(lock);
+		sched_yield();
+	}
+	assert(i < 1000);
+
+	/* and gets the lock once the last reader leaves */
+	assert(rwlock_unlock(lock) == 0);
+	pthread_join(tid, NULL);
+
+	assert(rwlock_trywrlock(lock) == 0);
+	assert(rwlock_tryrdlock(lock) == -1);
+	assert(rwlock_unlock(lock) == 0);
+	assert(rwlock_destroy(lock) == 0);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxcount = MAXCOUNT;
+
+	if (argc > 1)
+		maxcount = get_argv(argv[1]);
+
+	test_preference();
+	test_stress(maxcount);
+
+	return 0;
+}
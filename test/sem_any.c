@@ -0,0 +1,128 @@
+/*
+ * Wait-on-any test
+ *
+ * A dispatcher thread waits on several semaphores at once while producer
+ * threads release them, each producer feeding its own semaphore. Every
+ * released resource must be taken exactly once, from the right semaphore, and
+ * a woken dispatcher must no longer be registered on the other semaphores.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sem.h>
+
+#define NSEMS		3
+#define MAXCOUNT	1000
+
+struct producer {
+	sem_t sem;
+	size_t count;
+	pthread_t tid;
+};
+
+static void *producer(void *arg)
+{
+	struct producer *p = (struct producer*)arg;
+	size_t i;
+
+	for (i = 0; i < p->count; i++) {
+		sem_up(p->sem);
+		if (i % 7 == 0)
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static void test_single(sem_policy_t policy)
+{
+	sem_t sems[NSEMS];
+	size_t index;
+	int i, sval;
+
+	for (i = 0; i < NSEMS; i++)
+		sems[i] = sem_create_policy(0, policy);
+
+	/* the first available semaphore is taken */
+	sem_up(sems[2]);
+	sem_up(sems[1]);
+	assert(sem_down_any(sems, NSEMS, &index) == 0 && index == 1);
+	assert(sem_down_any(sems, NSEMS, &index) == 0 && index == 2);
+
+	/* errors */
+	assert(sem_down_any(NULL, NSEMS, &index) == -1);
+	assert(sem_down_any(sems, 0, &index) == -1);
+	assert(sem_down_any(sems, NSEMS, NULL) == -1);
+
+	for (i = 0; i < NSEMS; i++) {
+		sem_getvalue(sems[i], &sval);
+		assert(sval == 0);
+		assert(sem_destroy(sems[i]) == 0);
+	}
+}
+
+static void test_dispatch(sem_policy_t policy, size_t maxcount)
+{
+	struct producer p[NSEMS];
+	sem_t sems[NSEMS];
+	size_t taken[NSEMS] = { 0 };
+	size_t total = 0, index;
+	int i, sval;
+
+	for (i = 0; i < NSEMS; i++) {
+		sems[i] = sem_create_policy(0, policy);
+		p[i].sem = sems[i];
+		p[i].count = maxcount * (i + 1);
+		total += p[i].count;
+	}
+
+	for (i = 0; i < NSEMS; i++)
+		pthread_create(&p[i].tid, NULL, producer, &p[i]);
+
+	while (total--) {
+		assert(sem_down_any(sems, NSEMS, &index) == 0);
+		assert(index < NSEMS);
+		taken[index]++;
+	}
+
+	for (i = 0; i < NSEMS; i++) {
+		pthread_join(p[i].tid, NULL);
+		printf("semaphore %d: %zu taken\n", i, taken[i]);
+		assert(taken[i] == p[i].count);
+
+		/* nothing left, and no stale registration */
+		sem_getvalue(sems[i], &sval);
+		assert(sval == 0);
+		assert(sem_destroy(sems[i]) == 0);
+	}
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxcount = MAXCOUNT;
+
+	if (argc > 1)
+		maxcount = get_argv(argv[1]);
+
+	test_single(SEM_POLICY_FIFO);
+	test_single(SEM_POLICY_BARGING);
+	test_dispatch(SEM_POLICY_FIFO, maxcount);
+	test_dispatch(SEM_POLICY_BARGING, maxcount);
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Asynchronous semaphore take test
+ *
+ * A single thread registers thousands of pending takes on semaphores: their
+ * continuations must run in order, on the releasing thread, mixed fairly with
+ * blocked threads, and continuations releasing the resource must serve the
+ * next pending takes without nesting. With an executor, continuations must
+ * only run when the executor decides to. Finally, a continuation taking the
+ * lock released by cond_wait() must be run by another thread, and be able to
+ * signal the waiter.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cond.h>
+#include <sem.h>
+
+#define PENDING 10000
+
+static size_t served, next;
+static pthread_t releaser;
+
+/* in order, on the releasing thread, keeping the resource */
+static void keep(sem_t sem, void *arg)
+{
+	(void)sem;
+
+	assert((size_t)arg == next++);
+	assert(pthread_equal(pthread_self(), releaser));
+	served++;
+}
+
+static int depth, max_depth;
+
+/* pass the resource on to the next pending take */
+static void pass(sem_t sem, void *arg)
+{
+	(void)arg;
+
+	if (++depth > max_depth)
+		max_depth = depth;
+	served++;
+	sem_up(sem);
+	depth--;
+}
+
+static void immediate(void)
+{
+	sem_t sem = sem_create(1);
+
+	assert(sem_down_async(NULL, keep, NULL) == -1);
+	assert(sem_down_async(sem, NULL, NULL) == -1);
+	assert(sem_set_executor(NULL, NULL, NULL) == -1);
+
+	/* available: taken right away, no continuation */
+	assert(sem_down_async(sem, keep, NULL) == 0);
+	assert(served == 0);
+	assert(sem_up(sem) == 0);
+	assert(sem_destroy(sem) == 0);
+}
+
+static void ordered(void)
+{
+	sem_t sem = sem_create(0);
+	int value;
+	size_t i;
+
+	for (i = 0; i < PENDING; i++)
+		assert(sem_down_async(sem, keep, (void*)i) == 1);
+
+	assert(sem_getvalue(sem, &value) == 0 && value == -PENDING);
+	assert(sem_destroy(sem) == -1);
+
+	releaser = pthread_self();
+	for (i = 0; i < PENDING; i++) {
+		assert(sem_up(sem) == 0);
+		assert(served == i + 1);
+	}
+
+	assert(sem_getvalue(sem, &value) == 0 && value == 0);
+	assert(sem_destroy(sem) == 0);
+}
+
+static void chained(sem_policy_t policy)
+{
+	sem_t sem = sem_create_policy(0, policy);
+	int value;
+	size_t i;
+
+	served = 0;
+	max_depth = 0;
+
+	for (i = 0; i < PENDING; i++)
+		assert(sem_down_async(sem, pass, NULL) == 1);
+
+	/* one release serves all of them, one after the other */
+	assert(sem_up(sem) == 0);
+	assert(served == PENDING);
+	assert(max_depth == 1);
+
+	assert(sem_getvalue(sem, &value) == 0 && value == 1);
+	assert(sem_destroy(sem) == 0);
+}
+
+static sem_t mixed_sem;
+static int blocked_done;
+
+static void *blocked(void *arg)
+{
+	(void)arg;
+
+	sem_down(mixed_sem);
+	blocked_done = 1;
+
+	return NULL;
+}
+
+static void mixed(void)
+{
+	pthread_t tid;
+	int value;
+
+	mixed_sem = sem_create_policy(0, SEM_POLICY_BARGING);
+	served = 0;
+	next = 0;
+	releaser = pthread_self();
+
+	/* pending take, blocked thread, pending take */
+	assert(sem_down_async(mixed_sem, keep, (void*)0) == 1);
+	pthread_create(&tid, NULL, blocked, NULL);
+	do {
+		sched_yield();
+		sem_getvalue(mixed_sem, &value);
+	} while (value > -2);
+	assert(sem_down_async(mixed_sem, keep, (void*)1) == 1);
+
+	sem_up(mixed_sem);
+	assert(served == 1);
+	sem_up(mixed_sem);
+	pthread_join(tid, NULL);
+	assert(blocked_done && served == 1);
+	sem_up(mixed_sem);
+	assert(served == 2);
+
+	sem_destroy(mixed_sem);
+}
+
+/* executor delaying continuations to the main loop */
+static struct {
+	sem_callback_t callback;
+	sem_t sem;
+	void *arg;
+} tasks[PENDING];
+static size_t ntasks;
+
+static void defer(sem_callback_t callback, sem_t sem, void *arg, void *data)
+{
+	assert(data == &ntasks);
+	tasks[ntasks].callback = callback;
+	tasks[ntasks].sem = sem;
+	tasks[ntasks].arg = arg;
+	ntasks++;
+}
+
+static void executor(void)
+{
+	sem_t sem = sem_create(0);
+	size_t i;
+
+	served = 0;
+	next = 0;
+	assert(sem_set_executor(sem, defer, &ntasks) == 0);
+
+	for (i = 0; i < PENDING; i++)
+		assert(sem_down_async(sem, keep, (void*)i) == 1);
+	for (i = 0; i < PENDING; i++)
+		sem_up(sem);
+
+	assert(served == 0 && ntasks == PENDING);
+	for (i = 0; i < ntasks; i++)
+		tasks[i].callback(tasks[i].sem, tasks[i].arg);
+	assert(served == PENDING);
+
+	sem_destroy(sem);
+}
+
+static sem_t lock;
+static cond_t cond_flag;
+static int flag;
+
+/* take the lock released by cond_wait(), then wake the waiter up */
+static void set_flag(sem_t sem, void *arg)
+{
+	(void)arg;
+
+	assert(!pthread_equal(pthread_self(), releaser));
+	flag = 1;
+	cond_signal(cond_flag);
+	sem_up(sem);
+}
+
+static void monitor(void)
+{
+	lock = sem_create(1);
+	cond_flag = cond_create();
+	releaser = pthread_self();
+
+	sem_down(lock);
+	assert(sem_down_async(lock, set_flag, NULL) == 1);
+	while (!flag)
+		assert(cond_wait(cond_flag, lock) == 0);
+	sem_up(lock);
+
+	assert(cond_destroy(cond_flag) == 0);
+	assert(sem_destroy(lock) == 0);
+}
+
+int main(void)
+{
+	immediate();
+	ordered();
+	chained(SEM_POLICY_FIFO);
+	chained(SEM_POLICY_BARGING);
+	mixed();
+	executor();
+	monitor();
+
+	printf("%d pending takes served from one thread\n", PENDING);
+
+	return 0;
+}
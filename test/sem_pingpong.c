@@ -0,0 +1,97 @@
+/*
+ * Ping-pong test
+ *
+ * Two threads hand a token back and forth through a pair of semaphores, first
+ * with plain blocking semaphores then with adaptive ones. The token must make
+ * every round trip and the average latency of a hop is reported for both
+ * modes.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <sem.h>
+
+#define MAXCOUNT 100000
+
+struct pingpong {
+	sem_t ping;
+	sem_t pong;
+	size_t token;
+	size_t maxcount;
+};
+
+static void *ponger(void *arg)
+{
+	struct pingpong *p = (struct pingpong*)arg;
+	size_t i;
+
+	for (i = 0; i < p->maxcount; i++) {
+		sem_down(p->ping);
+		p->token++;
+		sem_up(p->pong);
+	}
+
+	return NULL;
+}
+
+static double run(size_t maxcount, int adaptive)
+{
+	struct pingpong p;
+	struct timespec start, end;
+	pthread_t tid;
+	size_t i;
+
+	p.ping = sem_create(0);
+	p.pong = sem_create(0);
+	p.token = 0;
+	p.maxcount = maxcount;
+	sem_set_adaptive(p.ping, adaptive);
+	sem_set_adaptive(p.pong, adaptive);
+
+	pthread_create(&tid, NULL, ponger, &p);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < maxcount; i++) {
+		p.token++;
+		sem_up(p.ping);
+		sem_down(p.pong);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	pthread_join(tid, NULL);
+	assert(p.token == 2 * maxcount);
+
+	sem_destroy(p.ping);
+	sem_destroy(p.pong);
+
+	return ((end.tv_sec - start.tv_sec) * 1e9 +
+		(end.tv_nsec - start.tv_nsec)) / (2.0 * maxcount);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxcount = MAXCOUNT;
+
+	if (argc > 1)
+		maxcount = get_argv(argv[1]);
+
+	printf("blocking: %.0f ns/hop\n", run(maxcount, 0));
+	printf("adaptive: %.0f ns/hop\n", run(maxcount, 1));
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Pollable semaphore test
+ *
+ * A worker thread releases a semaphore in bursts while the main thread runs an
+ * epoll loop on the semaphore's file descriptor, draining it with sem_trydown()
+ * each time it becomes readable. Every released resource must be collected,
+ * and the descriptor must only be readable while resources are available.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <sem.h>
+
+#define NBURSTS	100
+#define BURST	10
+
+static int readable(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+static void *worker(void *arg)
+{
+	sem_t sem = (sem_t)arg;
+	int i, j;
+
+	for (i = 0; i < NBURSTS; i++) {
+		for (j = 0; j < BURST; j++)
+			sem_up(sem);
+		usleep(100);
+	}
+
+	return NULL;
+}
+
+int main(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	sem_t sem = sem_create(2);
+	size_t collected = 0;
+	pthread_t tid;
+	int fd, epfd;
+
+	assert(sem_get_fd(NULL) == -1);
+	assert(sem_trydown(NULL) == -1);
+
+	/* descriptor reflects the initial count */
+	fd = sem_get_fd(sem);
+	assert(fd >= 0);
+	assert(sem_get_fd(sem) == fd);
+	assert(readable(fd));
+	assert(sem_trydown(sem) == 0);
+	assert(readable(fd));
+	assert(sem_trydown(sem) == 0);
+	assert(!readable(fd));
+	assert(sem_trydown(sem) == -1);
+
+	sem_up(sem);
+	assert(readable(fd));
+	sem_down(sem);
+	assert(!readable(fd));
+
+	/* event loop */
+	epfd = epoll_create1(0);
+	epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+	pthread_create(&tid, NULL, worker, sem);
+
+	while (collected < NBURSTS * BURST) {
+		assert(epoll_wait(epfd, &ev, 1, 5000) == 1);
+		while (sem_trydown(sem) == 0)
+			collected++;
+	}
+
+	pthread_join(tid, NULL);
+	printf("collected %zu resources\n", collected);
+
+	assert(!readable(fd));
+	close(epfd);
+	assert(sem_destroy(sem) == 0);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * Priority wake-up test
+ *
+ * Threads of different priorities block one after the other on a semaphore.
+ * Resources are then released one at a time, and the threads must be woken up
+ * from the highest priority to the lowest, in arrival order among threads of
+ * same priority.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sem.h>
+
+#define NTHREADS 8
+
+static const unsigned int prios[NTHREADS] = { 0, 5, 5, 31, 0, 10, 31, 1 };
+static const int expected[NTHREADS] = { 3, 6, 5, 1, 2, 7, 0, 4 };
+
+static sem_t sem, done;
+static int order[NTHREADS];
+static int woken;
+
+static void *waiter(void *arg)
+{
+	int id = (int)(long)arg;
+
+	sem_down_prio(sem, prios[id]);
+	order[woken++] = id;
+	sem_up(done);
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t tid[NTHREADS];
+	int i, sval;
+
+	sem = sem_create(0);
+	done = sem_create(0);
+
+	assert(sem_down_prio(NULL, 0) == -1);
+	assert(sem_down_prio(sem, SEM_PRIO_MAX + 1) == -1);
+
+	for (i = 0; i < NTHREADS; i++) {
+		pthread_create(&tid[i], NULL, waiter, (void*)(long)i);
+
+		/* wait until the thread is blocked to control arrival order */
+		do {
+			sched_yield();
+			sem_getvalue(sem, &sval);
+		} while (sval != -(i + 1));
+	}
+
+	for (i = 0; i < NTHREADS; i++) {
+		sem_up(sem);
+		sem_down(done);
+		printf("woke thread %d (priority %u)\n", order[i], prios[order[i]]);
+		assert(order[i] == expected[i]);
+	}
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	assert(sem_destroy(sem) == 0);
+	assert(sem_destroy(done) == 0);
+
+	return 0;
+}
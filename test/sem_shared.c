@@ -0,0 +1,226 @@
+/*
+ * Process-shared semaphore test
+ *
+ * A child process signals its parent through a shared semaphore opened by
+ * name, then another child takes a robust semaphore and dies without releasing
+ * it: the parent must get the resource back. Finally, more children than the
+ * semaphore can track take it in turn, the last one dying while holding it,
+ * and holder slots left with a wrong start time, as if their pid got reused,
+ * must be reclaimed whether the pid belongs to another process or to the one
+ * taking.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <sem.h>
+#include <sem_shared.h>
+
+#define MAXCOUNT 10000
+
+static char name[64];
+
+static void test_signal(size_t maxcount)
+{
+	sem_t sem = sem_create_shared(name, 0);
+	size_t i;
+	pid_t pid;
+	int sval, status;
+
+	assert(sem != NULL);
+
+	pid = fork();
+	if (pid == 0) {
+		/* open by name, as an unrelated process would */
+		sem_t child = sem_create_shared(name, 42);
+
+		for (i = 0; i < maxcount; i++)
+			sem_up(child);
+		sem_destroy(child);
+		exit(0);
+	}
+
+	for (i = 0; i < maxcount; i++)
+		assert(sem_down(sem) == 0);
+	assert(sem_trydown(sem) == -1);
+
+	waitpid(pid, &status, 0);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	sem_getvalue(sem, &sval);
+	assert(sval == 0);
+	printf("received %zu signals from child\n", maxcount);
+
+	assert(sem_destroy(sem) == 0);
+}
+
+static void test_robust(void)
+{
+	sem_t sem = sem_create_shared(name, 1);
+	pid_t pid;
+	int sval;
+
+	assert(sem_set_robust(sem, 1) == 0);
+
+	pid = fork();
+	if (pid == 0) {
+		sem_down(sem);
+		_exit(0); /* die while holding the semaphore */
+	}
+	waitpid(pid, NULL, 0);
+
+	sem_getvalue(sem, &sval);
+	assert(sval == 0);
+
+	/* blocks until the dead child's resource is reclaimed */
+	assert(sem_down(sem) == 0);
+	printf("recovered resource of dead child\n");
+
+	sem_up(sem);
+	sem_getvalue(sem, &sval);
+	assert(sval == 1);
+
+	assert(sem_destroy(sem) == 0);
+}
+
+#define CHILDREN 100 /* more than the tracked processes */
+
+static void test_slots(void)
+{
+	sem_t sem = sem_create_shared(name, 1);
+	pid_t pid;
+	int i, sval;
+
+	assert(sem_set_robust(sem, 1) == 0);
+
+	/* the slots of dead children must be reclaimed for the next ones */
+	for (i = 0; i < CHILDREN; i++) {
+		pid = fork();
+		if (pid == 0) {
+			if (sem_down(sem) == -1)
+				_exit(1);
+			if (i < CHILDREN - 1)
+				sem_up(sem);
+			_exit(0);
+		}
+		assert(waitpid(pid, &sval, 0) == pid);
+		assert(WIFEXITED(sval) && WEXITSTATUS(sval) == 0);
+	}
+
+	assert(sem_down(sem) == 0);
+	printf("recovered resource of dead child %d\n", CHILDREN);
+
+	sem_up(sem);
+	assert(sem_destroy(sem) == 0);
+}
+
+/* record @held resources in a free holder slot, for process @pid */
+static void plant(pid_t pid, uint64_t start, uint64_t held)
+{
+	int fd = shm_open(name, O_RDWR, 0);
+	struct sharedArea *area;
+	int i;
+
+	assert(fd != -1);
+	area = mmap(NULL, sizeof(*area), PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0);
+	assert(area != MAP_FAILED);
+	close(fd);
+
+	for (i = 0; area->_holders[i]._pid != 0; i++)
+		assert(i < SHARED_HOLDERS - 1);
+	area->_holders[i]._start = start;
+	area->_holders[i]._word = held;
+	__atomic_store_n(&area->_holders[i]._pid, pid, __ATOMIC_RELEASE);
+
+	munmap(area, sizeof(*area));
+}
+
+static void test_reused(void)
+{
+	sem_t sem = sem_create_shared(name, 0);
+	pid_t pid;
+	int status;
+
+	assert(sem_set_robust(sem, 1) == 0);
+
+	/* a live process, but not the one that took the resource */
+	pid = fork();
+	if (pid == 0) {
+		pause();
+		_exit(0);
+	}
+	plant(pid, 1, 1);
+	assert(sem_down(sem) == 0);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	printf("recovered resource of reused pid\n");
+
+	/* the current process, which must not inherit the resource */
+	pid = fork();
+	if (pid == 0) {
+		plant(getpid(), 1, 1);
+		_exit(sem_trydown(sem) == 0 ? 0 : 1);
+	}
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	sem_up(sem);
+	assert(sem_destroy(sem) == 0);
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	size_t maxcount = MAXCOUNT;
+	sem_t sem;
+	size_t index;
+
+	if (argc > 1)
+		maxcount = get_argv(argv[1]);
+
+	snprintf(name, sizeof(name), "/sem_shared_test_%d", getpid());
+
+	assert(sem_create_shared(NULL, 0) == NULL);
+	assert(sem_unlink(NULL) == -1);
+
+	/* unsupported operations */
+	sem = sem_create_shared(name, 0);
+	assert(sem_down_prio(sem, SEM_PRIO_MAX) == -1);
+	assert(sem_down_any(&sem, 1, &index) == -1);
+	assert(sem_get_fd(sem) == -1);
+	assert(sem_set_adaptive(sem, 1) == -1);
+	sem_destroy(sem);
+	assert(sem_unlink(name) == 0);
+	assert(sem_unlink(name) == -1);
+
+	test_signal(maxcount);
+	assert(sem_unlink(name) == 0);
+
+	test_robust();
+	assert(sem_unlink(name) == 0);
+
+	test_slots();
+	assert(sem_unlink(name) == 0);
+
+	test_reused();
+	assert(sem_unlink(name) == 0);
+
+	return 0;
+}
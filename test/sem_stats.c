@@ -0,0 +1,87 @@
+/*
+ * Semaphore statistics test
+ *
+ * A named semaphore is contended by several threads. When the library is built
+ * with statistics (`make STATS=1`), the counters must account for every
+ * resource taken and released, and the wait histogram for every blocking
+ * take. Otherwise, the statistics functions must consistently fail.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sem.h>
+
+#define NTHREADS 4
+#define LOOPS 1000
+
+static sem_t sem;
+
+static void *worker(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < LOOPS; i++)
+	{
+		sem_down(sem);
+		sched_yield();
+		sem_up(sem);
+	}
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t tid[NTHREADS];
+	struct sem_stats stats;
+	uint64_t hist = 0;
+	int i;
+
+	sem = sem_create(1);
+	assert(sem_set_name(NULL, "lock") == -1);
+	assert(sem_set_name(sem, "lock") == 0);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_create(&tid[i], NULL, worker, NULL);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	if (sem_get_stats(sem, &stats) == -1)
+	{
+		/* library built without statistics */
+		assert(sem_dump_stats(stdout) == -1);
+		printf("statistics disabled\n");
+		sem_destroy(sem);
+		return 0;
+	}
+
+	assert(sem_get_stats(NULL, &stats) == -1);
+	assert(strcmp(stats.name, "lock") == 0);
+	assert(stats.downs == NTHREADS * LOOPS);
+	assert(stats.ups == NTHREADS * LOOPS);
+	assert(stats.handoffs <= stats.blocking_downs);
+	assert(stats.blocking_downs <= stats.downs);
+	assert(stats.max_blocked < NTHREADS);
+
+	for (i = 0; i < SEM_STATS_BUCKETS; i++)
+		hist += stats.wait_hist[i];
+	assert(hist == stats.blocking_downs);
+	assert(stats.wait_max_ns <= stats.wait_total_ns);
+
+	assert(sem_dump_stats(stdout) == 0);
+
+	sem_destroy(sem);
+
+	printf("downs %lu, %lu blocking\n", (unsigned long)stats.downs,
+		   (unsigned long)stats.blocking_downs);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Stack pool test
+ *
+ * Released stacks must be handed out again to allocations of the same size
+ * class, and only to those. Threads created with pooled stacks must run on
+ * them, with the whole stack usable, and a thread overflowing its stack must
+ * hit the guard page.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <stack.h>
+
+#define NTHREADS 200
+#define SIZE (64 * 1024)
+
+static void *thread(void *arg)
+{
+	char local;
+	char *stack = arg;
+
+	/* running on the pooled stack, which is usable from bottom to top */
+	assert(&local > stack && &local < stack + SIZE);
+	memset(stack, 0xa5, 4096);
+
+	return arg;
+}
+
+static int depth(int n)
+{
+	volatile char frame[1024];
+
+	frame[0] = n;
+	return n > 0 ? depth(n - 1) + frame[0] : 0;
+}
+
+static void *overflow(void *arg)
+{
+	(void)arg;
+	depth(1000); /* about 1 MiB of frames */
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	void *stack, *again, *ret;
+	size_t size;
+	int i, status;
+	pid_t pid;
+
+	assert(stack_alloc(0) == NULL);
+	assert(stack_free(NULL, SIZE) == -1);
+	assert(stack_attr_init(NULL, SIZE) == -1);
+	assert(stack_attr_init(&attr, 1024) == -1);
+	assert(stack_attr_destroy(NULL) == -1);
+
+	/* reuse within a size class */
+	stack = stack_alloc(SIZE - 100);
+	assert(stack != NULL);
+	memset(stack, 1, SIZE);
+	assert(stack_free(stack, SIZE - 100) == 0);
+	again = stack_alloc(SIZE);
+	assert(again == stack);
+	assert(stack_free(again, SIZE) == 0);
+	again = stack_alloc(2 * SIZE);
+	assert(again != stack);
+	assert(stack_free(again, 2 * SIZE) == 0);
+
+	/* oversized stacks are not pooled, but work all the same */
+	stack = stack_alloc(STACK_MAX_POOLED + 1);
+	assert(stack != NULL);
+	memset(stack, 1, STACK_MAX_POOLED + 1);
+	assert(stack_free(stack, STACK_MAX_POOLED + 1) == 0);
+
+	/* threads on pooled stacks */
+	for (i = 0; i < NTHREADS; i++) {
+		assert(stack_attr_init(&attr, SIZE) == 0);
+		assert(pthread_attr_getstack(&attr, &stack, &size) == 0);
+		assert(size == SIZE);
+		assert(pthread_create(&tid, &attr, thread, stack) == 0);
+		assert(pthread_join(tid, &ret) == 0);
+		assert(ret == stack);
+		assert(stack_attr_destroy(&attr) == 0);
+	}
+
+	assert(stack_pool_trim() > 0);
+	assert(stack_pool_trim() == 0);
+
+	/* overflow, in a child since it crashes */
+	pid = fork();
+	if (pid == 0) {
+		assert(stack_attr_init(&attr, SIZE) == 0);
+		pthread_create(&tid, &attr, overflow, NULL);
+		pthread_join(tid, NULL);
+		_exit(0);
+	}
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+
+	printf("%d threads on pooled stacks\n", NTHREADS);
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Cache topology test
+ *
+ * Check the cache sharing reported for the cpus of the machine against itself
+ * (a cpu always shares its caches with itself, and two cpus share a last-level
+ * cache exactly when each one lists the other), then place a few threads and
+ * check that each one got restricted to cpus it was allowed on.
+ */
+
+#define _GNU_SOURCE
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sem.h>
+#include <topo.h>
+
+#define NTHREADS 4
+#define MAXCPUS 256
+
+static cpu_set_t allowed;
+static sem_t placed;
+
+static void *stage(void *arg)
+{
+	cpu_set_t set;
+	int cpu;
+
+	(void)arg;
+	sem_down(placed);
+
+	assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+	assert(CPU_COUNT(&set) > 0);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		assert(!CPU_ISSET(cpu, &set) || CPU_ISSET(cpu, &allowed));
+
+	return NULL;
+}
+
+int main(void)
+{
+	int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int llc[MAXCPUS], l2[MAXCPUS];
+	pthread_t tid[NTHREADS];
+	int cpu, n, i, j;
+
+	assert(topo_cache_cpus(0, 0, NULL, 0) == -1);
+	assert(topo_cache_cpus(-1, 0, llc, MAXCPUS) == -1);
+	assert(topo_share_cache(-1, 0) == 0);
+	assert(topo_place_stages(NULL, 1) == -1);
+	assert(topo_place_stages(tid, 0) == -1);
+
+	for (cpu = 0; cpu < ncpus && cpu < MAXCPUS; cpu++) {
+		assert(topo_share_cache(cpu, cpu) == 1);
+
+		n = topo_cache_cpus(cpu, 0, llc, MAXCPUS);
+		if (n == -1)
+			continue; /* no topology exposed, e.g. in some VMs */
+		assert(n >= 1 && n <= MAXCPUS);
+
+		for (i = 0; i < n && llc[i] != cpu; i++)
+			;
+		assert(i < n);
+
+		/* the L2 cache is shared by a subset of the llc sharers */
+		j = topo_cache_cpus(cpu, 2, l2, MAXCPUS);
+		assert(j == -1 || j <= n);
+
+		for (i = 0; i < n; i++)
+			assert(topo_share_cache(cpu, llc[i]) == 1);
+	}
+
+	printf("%d cpus, %d sharing the last-level cache of cpu 0\n", ncpus,
+	       topo_cache_cpus(0, 0, llc, MAXCPUS));
+
+	assert(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+	placed = sem_create(0);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_create(&tid[i], NULL, stage, NULL);
+	assert(topo_place_stages(tid, NTHREADS) == 0);
+	for (i = 0; i < NTHREADS; i++)
+		sem_up(placed);
+	for (i = 0; i < NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	sem_destroy(placed);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * TPS dirty range tracking test
+ *
+ * Checks the ranges reported for a few known writes, then keeps a replica of
+ * the TPS up to date through random writes and checkpoints copying only the
+ * dirty ranges: the replica must always match the TPS, every written byte
+ * must be covered, and the volume copied must follow the volume written.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tps.h>
+
+#define CHECKPOINTS 1000
+#define WRITES 8
+
+static char replica[TPS_SIZE];
+
+/* Copy the dirty ranges of the TPS to the replica, return bytes copied */
+static size_t checkpoint(void)
+{
+	struct tps_range ranges[TPS_DIRTY_MAX_RANGES];
+	size_t copied = 0;
+	int i, n;
+
+	n = tps_dirty_ranges(ranges, TPS_DIRTY_MAX_RANGES);
+	assert(n >= 0);
+
+	for (i = 0; i < n; i++) {
+		assert(i == 0 || ranges[i].offset >
+		       ranges[i - 1].offset + ranges[i - 1].length);
+		assert(ranges[i].offset + ranges[i].length <= TPS_SIZE);
+		assert(tps_read(ranges[i].offset, ranges[i].length,
+				replica + ranges[i].offset) == 0);
+		copied += ranges[i].length;
+	}
+
+	assert(tps_clear_dirty() == 0);
+
+	return copied;
+}
+
+static void expect(const struct tps_range *expected, int count)
+{
+	struct tps_range ranges[TPS_DIRTY_MAX_RANGES];
+	int i;
+
+	assert(tps_dirty_ranges(ranges, TPS_DIRTY_MAX_RANGES) == count);
+	for (i = 0; i < count; i++) {
+		assert(ranges[i].offset == expected[i].offset);
+		assert(ranges[i].length == expected[i].length);
+	}
+}
+
+static void *cloner(void *arg)
+{
+	struct tps_range all = { 0, TPS_SIZE };
+
+	assert(tps_clone(*(pthread_t*)arg) == 0);
+	expect(&all, 1);
+	assert(tps_destroy() == 0);
+
+	return NULL;
+}
+
+static void *thread(void *arg)
+{
+	struct tps_range all = { 0, TPS_SIZE };
+	struct tps_range merged[] = { { 10, 30 }, { 100, 1 } };
+	struct tps_range ranges[2];
+	char buffer[TPS_SIZE], data[256];
+	size_t offset, length, written = 0, copied = 0;
+	pthread_t self = pthread_self(), clone;
+	int c, w;
+
+	(void)arg;
+	memset(data, 0x5a, sizeof(data));
+
+	assert(tps_dirty_ranges(ranges, 2) == -1);
+	assert(tps_clear_dirty() == -1);
+	assert(tps_create() == 0);
+	assert(tps_dirty_ranges(NULL, 2) == -1);
+	assert(tps_dirty_ranges(ranges, 0) == -1);
+
+	/* a new TPS is entirely dirty */
+	expect(&all, 1);
+	checkpoint();
+	expect(NULL, 0);
+
+	/* overlapping and adjacent writes merge, distinct ones do not */
+	assert(tps_write(100, 1, data) == 0);
+	assert(tps_write(20, 10, data) == 0);
+	assert(tps_write(10, 15, data) == 0);
+	assert(tps_write(30, 10, data) == 0);
+	assert(tps_write(50, 0, data) == 0);
+	expect(merged, 2);
+
+	/* ranges that do not fit are folded into the last one */
+	assert(tps_dirty_ranges(ranges, 1) == 1);
+	assert(ranges[0].offset == 10 && ranges[0].length == 91);
+
+	/* too many ranges: the closest ones merge */
+	for (c = 0; c < TPS_DIRTY_MAX_RANGES; c++)
+		assert(tps_write(1000 + c * 100, 1, data) == 0);
+	assert(tps_dirty_ranges(ranges, 1) == 1);
+	assert(tps_write(4095, 1, data) == 0);
+	checkpoint();
+
+	pthread_create(&clone, NULL, cloner, &self);
+	pthread_join(clone, NULL);
+
+	/* random writes between checkpoints */
+	for (c = 0; c < CHECKPOINTS; c++) {
+		for (w = 0; w < WRITES; w++) {
+			offset = rand() % TPS_SIZE;
+			length = rand() % sizeof(data);
+			if (offset + length > TPS_SIZE)
+				length = TPS_SIZE - offset;
+			data[0] = rand();
+			assert(tps_write(offset, length, data) == 0);
+			written += length;
+		}
+		copied += checkpoint();
+
+		assert(tps_read(0, TPS_SIZE, buffer) == 0);
+		assert(memcmp(buffer, replica, TPS_SIZE) == 0);
+	}
+
+	printf("%d checkpoints: %zu bytes written, %zu copied, %zu for full copies\n",
+	       CHECKPOINTS, written, copied, (size_t)CHECKPOINTS * TPS_SIZE);
+	assert(copied < (size_t)CHECKPOINTS * TPS_SIZE / 2);
+
+	assert(tps_destroy() == 0);
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t tid;
+
+	assert(tps_init(0) == 0);
+
+	pthread_create(&tid, NULL, thread, NULL);
+	pthread_join(tid, NULL);
+
+	return 0;
+}
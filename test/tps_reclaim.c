@@ -0,0 +1,161 @@
+/*
+ * TPS reclaiming test
+ *
+ * Idle threads fill their TPS with compressible content, and get their pages
+ * reclaimed explicitly and then by the background reclaimer. Pages must read
+ * back intact (including through a clone sharing a reclaimed page), resident
+ * memory must go down, and pages with incompressible content must be left
+ * alone.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sem.h>
+#include <tps.h>
+
+#define NTHREADS 64
+
+static sem_t filled, wake;
+static char pattern[TPS_SIZE];
+static char noise[TPS_SIZE];
+static pthread_t owner; /* thread whose TPS gets cloned */
+
+/* Resident memory of the process, in pages */
+static long resident(void)
+{
+	long size, rss;
+	FILE *f = fopen("/proc/self/statm", "r");
+
+	assert(f != NULL);
+	assert(fscanf(f, "%ld %ld", &size, &rss) == 2);
+	fclose(f);
+
+	return rss;
+}
+
+static void check(const char *expected)
+{
+	char buffer[TPS_SIZE];
+
+	assert(tps_read(0, TPS_SIZE, buffer) == 0);
+	assert(memcmp(buffer, expected, TPS_SIZE) == 0);
+}
+
+static void *idle(void *arg)
+{
+	long id = (long)arg;
+
+	assert(tps_create() == 0);
+	assert(tps_write(0, TPS_SIZE, id == 0 ? noise : pattern) == 0);
+	sem_up(filled);
+
+	/* idle until told to check the content again */
+	sem_down(wake);
+	check(id == 0 ? noise : pattern);
+
+	/* one more round, reclaimed in the background this time */
+	sem_up(filled);
+	sem_down(wake);
+	check(id == 0 ? noise : pattern);
+
+	assert(tps_destroy() == 0);
+
+	return NULL;
+}
+
+static void *cloner(void *arg)
+{
+	(void)arg;
+
+	/* clone a reclaimed page, then write to it */
+	assert(tps_clone(owner) == 0);
+	check(pattern);
+	assert(tps_write(0, 5, "clone") == 0);
+	assert(tps_destroy() == 0);
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t tid[NTHREADS], clone;
+	struct tps_reclaim_stats stats;
+	long before, after;
+	int i, n;
+
+	for (i = 0; i < TPS_SIZE; i++) {
+		pattern[i] = "idle thread "[i % 12];
+		noise[i] = rand();
+	}
+
+	assert(tps_reclaim(0) == -1);
+	assert(tps_init(1) == 0);
+	assert(tps_get_reclaim_stats(NULL) == -1);
+	assert(tps_reclaim_start(0) == -1);
+	assert(tps_reclaim_stop() == -1);
+
+	filled = sem_create(0);
+	wake = sem_create(0);
+
+	for (i = 0; i < NTHREADS; i++)
+		pthread_create(&tid[i], NULL, idle, (void*)(long)i);
+	for (i = 0; i < NTHREADS; i++)
+		sem_down(filled);
+	owner = tid[1];
+
+	/* pages were just written, they are not idle */
+	assert(tps_reclaim(60000) == 0);
+
+	before = resident();
+	n = tps_reclaim(0);
+	after = resident();
+	assert(n == NTHREADS - 1); /* all but the noise */
+
+	assert(tps_get_reclaim_stats(&stats) == 0);
+	assert(stats.reclaimed_pages == NTHREADS - 1);
+	assert(stats.compressed_bytes < (NTHREADS - 1) * TPS_SIZE / 8);
+	assert(after < before);
+	printf("reclaimed %d pages into %zu bytes, rss %ld -> %ld pages\n",
+	       n, stats.compressed_bytes, before, after);
+
+	pthread_create(&clone, NULL, cloner, NULL);
+	pthread_join(clone, NULL);
+
+	for (i = 0; i < NTHREADS; i++)
+		sem_up(wake);
+	for (i = 0; i < NTHREADS; i++)
+		sem_down(filled);
+
+	assert(tps_get_reclaim_stats(&stats) == 0);
+	assert(stats.reclaimed_pages == 0);
+	assert(stats.cold_accesses == NTHREADS - 1);
+	printf("cold access: %lu ns on average\n",
+	       (unsigned long)(stats.cold_access_ns / stats.cold_accesses));
+
+	/* background reclaimer */
+	assert(tps_reclaim_start(20) == 0);
+	assert(tps_reclaim_start(20) == -1);
+	usleep(200000);
+	assert(tps_reclaim_stop() == 0);
+
+	assert(tps_get_reclaim_stats(&stats) == 0);
+	assert(stats.reclaimed_pages == NTHREADS - 1);
+
+	for (i = 0; i < NTHREADS; i++)
+		sem_up(wake);
+	for (i = 0; i < NTHREADS; i++)
+		pthread_join(tid[i], NULL);
+
+	assert(tps_get_reclaim_stats(&stats) == 0);
+	assert(stats.reclaimed_pages == 0);
+
+	sem_destroy(filled);
+	sem_destroy(wake);
+
+	return 0;
+}
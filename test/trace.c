@@ -0,0 +1,159 @@
+/*
+ * Event tracing test
+ *
+ * Two threads hand a semaphore back and forth, and a third one writes to a
+ * TPS page shared with the main thread. When the library is built with
+ * tracing (`make TRACE=1`), the dump must hold the events of all of them as a
+ * Chrome trace, and be empty after a reset. Otherwise, the tracing functions
+ * must consistently fail.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sem.h>
+#include <tps.h>
+#include <trace.h>
+
+#define PINGS 100
+#define LOOPS 100000
+
+static sem_t ping, pong;
+
+static void *ponger(void *arg)
+{
+	int i;
+
+	(void)arg;
+
+	for (i = 0; i < PINGS; i++) {
+		sem_down(ping);
+		sem_up(pong);
+	}
+
+	return NULL;
+}
+
+static void *cloner(void *arg)
+{
+	assert(tps_clone(*(pthread_t*)arg) == 0);
+	assert(tps_write(0, 1, "x") == 0);
+	assert(tps_destroy() == 0);
+
+	return NULL;
+}
+
+/* Count the occurrences of @pattern in @text */
+static int occurrences(const char *text, const char *pattern)
+{
+	int n = 0;
+
+	while ((text = strstr(text, pattern)) != NULL) {
+		text += strlen(pattern);
+		n++;
+	}
+
+	return n;
+}
+
+static char *dump(long *count)
+{
+	char *text;
+	size_t size;
+	FILE *f = open_memstream(&text, &size);
+
+	*count = trace_dump(f);
+	fclose(f);
+
+	return text;
+}
+
+int main(void)
+{
+	pthread_t tid, self = pthread_self();
+	struct timespec t0, t1;
+	sem_t sem = sem_create(1);
+	long count;
+	char *text;
+	int i;
+
+	ping = sem_create(0);
+	pong = sem_create(0);
+	pthread_create(&tid, NULL, ponger, NULL);
+	for (i = 0; i < PINGS; i++) {
+		sem_up(ping);
+		sem_down(pong);
+	}
+	pthread_join(tid, NULL);
+
+	assert(tps_init(0) == 0);
+	assert(tps_create() == 0);
+	pthread_create(&tid, NULL, cloner, &self);
+	pthread_join(tid, NULL);
+	assert(tps_destroy() == 0);
+
+	if (trace_reset() == -1) {
+		/* library built without tracing */
+		assert(trace_dump(stdout) == -1);
+		printf("tracing disabled\n");
+		return 0;
+	}
+
+	assert(trace_dump(NULL) == -1);
+
+	/* the reset emptied the rings */
+	text = dump(&count);
+	assert(count == 0);
+	free(text);
+
+	pthread_create(&tid, NULL, ponger, NULL);
+	for (i = 0; i < PINGS; i++) {
+		sem_up(ping);
+		sem_down(pong);
+	}
+	pthread_join(tid, NULL);
+
+	assert(tps_create() == 0);
+	pthread_create(&tid, NULL, cloner, &self);
+	pthread_join(tid, NULL);
+	assert(tps_destroy() == 0);
+
+	text = dump(&count);
+	assert(count > 0);
+	assert(strncmp(text, "{\"traceEvents\":[", 16) == 0);
+	assert(strcmp(text + strlen(text) - 4, "\n]}\n") == 0);
+	assert(occurrences(text, "\"name\"") == count);
+
+	/* both threads go down and up the semaphores, each time */
+	assert(occurrences(text, "\"name\":\"sem_up\"") >= 2 * PINGS);
+	assert(occurrences(text, "\"name\":\"sem_down\",\"cat\":\"sem\",\"ph\":\"B\"")
+	       == occurrences(text, "\"name\":\"sem_down\",\"cat\":\"sem\",\"ph\":\"E\""));
+	assert(occurrences(text, "\"name\":\"blocked\"") > 0);
+	assert(occurrences(text, "\"name\":\"unblock\"") > 0);
+	assert(occurrences(text, "\"name\":\"critical_section\",\"cat\":\"thread\",\"ph\":\"B\"")
+	       == occurrences(text, "\"name\":\"critical_section\",\"cat\":\"thread\",\"ph\":\"E\""));
+	assert(occurrences(text, "\"name\":\"tps_cow\"") == 2);
+	free(text);
+
+	/* cost of the probes: 7 events per uncontended down and up */
+	trace_reset();
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < LOOPS; i++) {
+		sem_down(sem);
+		sem_up(sem);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("%ld events, %.0f ns per uncontended down and up\n", count,
+	       ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) /
+	       LOOPS);
+
+	sem_destroy(sem);
+	sem_destroy(ping);
+	sem_destroy(pong);
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * User-level threads test
+ *
+ * Create uthreads from a regular thread and from other uthreads, join them
+ * from both, and check that uthreads blocked on semaphores are parked and
+ * resumed: a ring of uthreads passes a token around through semaphores many
+ * more times than there are workers, which would deadlock if a blocked uthread
+ * held on to its worker. The ring runs a second time with wake-affine
+ * semaphores, each token going straight to the worker that passed it. Finally,
+ * a uthread woken up by a wake-affine semaphore must not wait for its waker to
+ * be done while another worker is idle.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <sem.h>
+#include <uthread.h>
+
+#define NWORKERS 2
+#define NRING 1000
+#define LAPS 20
+#define NYIELDERS 100
+
+static sem_t ring[NRING];
+static size_t passes;
+static size_t yields;
+
+static void *ring_member(void *arg)
+{
+	size_t i = (size_t)arg;
+	int lap;
+
+	for (lap = 0; lap < LAPS; lap++) {
+		sem_down(ring[i]);
+		passes++;
+		sem_up(ring[(i + 1) % NRING]);
+	}
+
+	return (void*)i;
+}
+
+static void *yielder(void *arg)
+{
+	int i;
+
+	assert(uthread_self() != NULL);
+
+	for (i = 0; i < 10; i++) {
+		__atomic_fetch_add(&yields, 1, __ATOMIC_RELAXED);
+		uthread_yield();
+	}
+
+	if (arg != NULL)
+		uthread_exit(arg);
+
+	return NULL;
+}
+
+/* joins uthreads from within a uthread */
+static void *spawner(void *arg)
+{
+	uthread_t children[NYIELDERS];
+	void *ret;
+	size_t i;
+
+	(void)arg;
+
+	for (i = 0; i < NYIELDERS; i++)
+		children[i] = uthread_create(yielder, (void*)(i + 1));
+
+	for (i = 0; i < NYIELDERS; i++) {
+		assert(uthread_join(children[i], &ret) == 0);
+		assert((size_t)ret == i + 1);
+	}
+
+	return NULL;
+}
+
+static void run_ring(int affine)
+{
+	uthread_t ut[NRING];
+	void *ret;
+	size_t i;
+
+	passes = 0;
+	for (i = 0; i < NRING; i++) {
+		ring[i] = sem_create(0);
+		assert(sem_set_wake_affine(ring[i], affine) == 0);
+	}
+
+	for (i = 0; i < NRING; i++)
+		ut[i] = uthread_create(ring_member, (void*)i);
+
+	sem_up(ring[0]);
+
+	for (i = 0; i < NRING; i++) {
+		assert(uthread_join(ut[i], &ret) == 0);
+		assert((size_t)ret == i);
+	}
+
+	assert(passes == NRING * LAPS);
+
+	for (i = 0; i < NRING; i++)
+		sem_destroy(ring[i]);
+}
+
+static sem_t go;
+static int woken;
+
+static void *sleeper(void *arg)
+{
+	(void)arg;
+
+	sem_down(go);
+	__atomic_store_n(&woken, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/* wakes the sleeper up, then keeps its worker until the sleeper ran */
+static void *busy_waker(void *arg)
+{
+	int value;
+
+	(void)arg;
+
+	do {
+		uthread_yield();
+		sem_getvalue(go, &value);
+	} while (value == 0);
+
+	sem_up(go);
+	while (!__atomic_load_n(&woken, __ATOMIC_ACQUIRE))
+		;
+
+	return NULL;
+}
+
+static void run_busy_waker(void)
+{
+	uthread_t ut[2];
+
+	go = sem_create(0);
+	assert(sem_set_wake_affine(go, 1) == 0);
+
+	ut[0] = uthread_create(sleeper, NULL);
+	ut[1] = uthread_create(busy_waker, NULL);
+	assert(uthread_join(ut[0], NULL) == 0);
+	assert(uthread_join(ut[1], NULL) == 0);
+
+	sem_destroy(go);
+}
+
+int main(void)
+{
+	uthread_t ut;
+
+	assert(uthread_self() == NULL);
+	assert(uthread_create(NULL, NULL) == NULL);
+	assert(uthread_join(NULL, NULL) == -1);
+	assert(uthread_init(NWORKERS) == 0);
+	assert(uthread_init(NWORKERS) == -1);
+
+	/* yields and joins within uthreads */
+	ut = uthread_create(spawner, NULL);
+	assert(uthread_join(ut, NULL) == 0);
+	assert(yields == NYIELDERS * 10);
+
+	/* token ring */
+	assert(sem_set_wake_affine(NULL, 1) == -1);
+	run_ring(0);
+	run_ring(1);
+
+	run_busy_waker();
+
+	printf("%zu passes, %zu yields\n", passes, yields);
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Sieve test for finding prime numbers, with user-level threads
+ *
+ * Same pipeline as sem_prime, except that the source, the sink and every
+ * filter are uthreads rather than kernel threads, all multiplexed over the
+ * default pool of workers.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sem.h>
+#include <uthread.h>
+
+#define MAXPRIME 1000
+
+struct channel {
+	int value;
+	sem_t produce;
+	sem_t consume;
+};
+
+struct filter {
+	struct channel *left;
+	struct channel *right;
+	unsigned int prime;
+	uthread_t tid;
+	struct filter *next;
+};
+
+static unsigned int max = MAXPRIME;
+
+/* Producer thread: produces all numbers, from 2 to max */
+static void *source(void *arg)
+{
+	struct channel *c = (struct channel*) arg;
+	size_t i;
+
+	for (i = 2; i <= max; i++) {
+		c->value = i;
+		sem_up(c->consume);
+		sem_down(c->produce);
+	}
+
+	/* mark completion */
+	c->value = -1;
+	sem_up(c->consume);
+	sem_down(c->produce);
+
+	return NULL;
+}
+
+/* Filter thread */
+static void *filter(void *arg)
+{
+	struct filter *f = (struct filter*) arg;
+	int value;
+
+	while (1) {
+		sem_down(f->left->consume);
+		value = f->left->value;
+		sem_up(f->left->produce);
+		if ((value == -1) || (value % f->prime != 0)) {
+			f->right->value = value;
+			sem_up(f->right->consume);
+			sem_down(f->right->produce);
+		}
+		if (value == -1)
+			break;
+	}
+
+	return NULL;
+}
+
+/* Consumer thread */
+static void *sink(void *arg)
+{
+	struct channel *init_p, *p;
+	int value;
+	uthread_t tid;
+	struct filter *f_head = NULL;
+
+	init_p = malloc(sizeof(*init_p));
+
+	p = init_p;
+	p->produce = sem_create(0);
+	p->consume = sem_create(0);
+
+	tid = uthread_create(source, p);
+
+	while (1) {
+		struct filter *f;
+
+		sem_down(p->consume);
+		value = p->value;
+		sem_up(p->produce);
+
+		if (value == -1)
+			break;
+
+		printf("%d is prime.\n", value);
+
+		f = malloc(sizeof(*f));
+		f->left = p;
+		f->prime = value;
+		f->next = NULL;
+
+		p = malloc(sizeof(*p));
+		p->produce = sem_create(0);
+		p->consume = sem_create(0);
+
+		f->right = p;
+
+		f->tid = uthread_create(filter, f);
+
+		if (f_head)
+			f->next = f_head;
+		f_head = f;
+	}
+
+	uthread_join(tid, NULL);
+	sem_destroy(init_p->produce);
+	sem_destroy(init_p->consume);
+	free(init_p);
+
+	while (f_head) {
+		struct filter *old = f_head;
+
+		uthread_join(f_head->tid, NULL);
+		sem_destroy(f_head->right->produce);
+		sem_destroy(f_head->right->consume);
+		free(f_head->right);
+		f_head = f_head->next;
+		free(old);
+	}
+
+	return NULL;
+}
+
+static unsigned int get_argv(char *argv)
+{
+	long int ret = strtol(argv, NULL, 0);
+
+	if (ret == LONG_MIN || ret == LONG_MAX) {
+		perror("strtol");
+		exit(1);
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	uthread_t tid;
+
+	if (argc > 1)
+		max = get_argv(argv[1]);
+
+	tid = uthread_create(sink, NULL);
+	uthread_join(tid, NULL);
+
+	return 0;
+}